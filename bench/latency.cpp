@@ -0,0 +1,524 @@
+// nadi_latency: loads any NADI library, creates nodes in it and drives them with timestamped
+// messages on a user channel, at a fixed rate or as fast as they are taken. Every message coming
+// back through the receive callback carrying such a stamp, from any of the nodes, yields one
+// round-trip latency, so a node echoing its input and a pair of bridges connected to each other
+// are measured alike. Latencies go into an HDR histogram and are reported as percentiles.
+
+#include <nadi/extended_message.hpp>
+#include <nadi/message_pool.hpp>
+#include <nadi/meta_registry.hpp>
+#include <nadi/nadi.h>
+#include <nadi/segmented_message.hpp>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <dlfcn.h>
+
+namespace {
+
+constexpr unsigned int configuration_channel = 0xF100;
+constexpr unsigned int reserved_channels = 0xF000;
+
+// Leads the payload of every message sent, the rest is zero.
+struct stamp {
+    std::uint64_t magic;
+    std::uint64_t sequence;
+    std::int64_t sent; // steady_clock nanoseconds, the due time if paced, else right before the first nadi_send
+};
+
+constexpr std::uint64_t stamp_magic = 0x59434E4554414C4E; // "NLATENCY"
+
+std::int64_t now() noexcept {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Log-linear buckets as in HdrHistogram with three significant digits: values below 2048 ns have
+// a bucket each, every power of two above is split into 1024 buckets, so a reported percentile
+// is at most 0.1% above the recorded value. Counts are atomic for recording from node threads.
+class histogram {
+public:
+    void record(std::uint64_t value) noexcept {
+        counts_[index_of(value)].fetch_add(1, std::memory_order_relaxed);
+        total_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(value, std::memory_order_relaxed);
+        std::uint64_t seen = min_.load(std::memory_order_relaxed);
+        while (value < seen && !min_.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {}
+        seen = max_.load(std::memory_order_relaxed);
+        while (value > seen && !max_.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {}
+    }
+
+    std::uint64_t count() const noexcept { return total_.load(std::memory_order_relaxed); }
+    std::uint64_t min() const noexcept { return count() ? min_.load(std::memory_order_relaxed) : 0; }
+    std::uint64_t max() const noexcept { return max_.load(std::memory_order_relaxed); }
+    double mean() const noexcept { return count() ? static_cast<double>(sum_.load(std::memory_order_relaxed)) / count() : 0; }
+
+    // Highest value equivalent to the one at or below which percentile percent of the values are.
+    std::uint64_t percentile(double percent) const noexcept {
+        std::uint64_t total = count();
+        if (!total) return 0;
+        auto rank = static_cast<std::uint64_t>(percent / 100 * static_cast<double>(total) + 0.5);
+        rank = std::clamp<std::uint64_t>(rank, 1, total);
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < bucket_count; ++i) {
+            seen += counts_[i].load(std::memory_order_relaxed);
+            if (seen >= rank) return std::min(highest_of(i), max());
+        }
+        return max();
+    }
+
+private:
+    static constexpr int sub_bits = 11;
+    static constexpr std::uint64_t sub_count = 1u << sub_bits;
+    static constexpr std::uint64_t half_count = sub_count / 2;
+    static constexpr std::size_t bucket_count = sub_count + (64 - sub_bits) * half_count;
+
+    static std::size_t index_of(std::uint64_t value) noexcept {
+        if (value < sub_count) return value;
+        int shift = std::bit_width(value) - sub_bits; // leaves value >> shift in [half_count, sub_count)
+        return sub_count + (shift - 1) * half_count + ((value >> shift) - half_count);
+    }
+
+    static std::uint64_t highest_of(std::size_t index) noexcept {
+        if (index < sub_count) return index;
+        int shift = static_cast<int>((index - sub_count) / half_count) + 1;
+        std::uint64_t sub = (index - sub_count) % half_count + half_count;
+        return ((sub + 1) << shift) - 1;
+    }
+
+    std::atomic<std::uint64_t> counts_[bucket_count] = {};
+    std::atomic<std::uint64_t> total_{0};
+    std::atomic<std::uint64_t> sum_{0};
+    std::atomic<std::uint64_t> min_{std::numeric_limits<std::uint64_t>::max()};
+    std::atomic<std::uint64_t> max_{0};
+};
+
+struct options {
+    std::string library;
+    int nodes = 1;
+    std::vector<int> senders;                     // empty for all nodes
+    std::vector<std::pair<int, std::string>> configs; // node index, -1 for all nodes
+    unsigned int channel = 1;
+    std::size_t size = 64;
+    double rate = 10000; // messages per second and sender, 0 to send as fast as they are taken
+    double duration = 5;
+    double warmup = 1;
+    double settle = 2;
+    double drain = 1;
+    bool json = false;
+};
+
+constexpr const char* usage =
+    "usage: nadi_latency <library> [options]\n"
+    "  --nodes=N            nodes to create (1)\n"
+    "  --send=I             index of a node to send to, repeatable (all nodes)\n"
+    "  --config=[I:]JSON    message for the 0xF100 input of node I or of every node, repeatable\n"
+    "  --channel=C          user channel to send on (1)\n"
+    "  --size=BYTES         payload size, at least 24 (64)\n"
+    "  --rate=N             messages per second and sender, 0 for as fast as they are taken (10000)\n"
+    "  --duration=SECONDS   measured time (5)\n"
+    "  --warmup=SECONDS     time sent but not measured before (1)\n"
+    "  --settle=SECONDS     longest wait for replies to --config (2)\n"
+    "  --drain=SECONDS      longest wait for outstanding messages after sending (1)\n"
+    "  --json               print the result as one JSON object\n";
+
+struct usage_error : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+double number(std::string_view name, std::string_view text) {
+    try {
+        std::size_t used = 0;
+        double value = std::stod(std::string{text}, &used);
+        if (used == text.size() && value >= 0) return value;
+    } catch (const std::exception&) {
+    }
+    throw usage_error{"invalid value for --" + std::string{name} + ": " + std::string{text}};
+}
+
+options parse(int argc, char** argv) {
+    options opt;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if (!arg.starts_with("--")) {
+            if (!opt.library.empty()) throw usage_error{"more than one library given"};
+            opt.library = arg;
+            continue;
+        }
+        arg.remove_prefix(2);
+        auto equals = arg.find('=');
+        std::string_view name = arg.substr(0, equals);
+        std::string_view value = equals == std::string_view::npos ? std::string_view{} : arg.substr(equals + 1);
+        if (name == "json" && equals == std::string_view::npos) {
+            opt.json = true;
+        } else if (equals == std::string_view::npos) {
+            throw usage_error{"missing value for --" + std::string{name}};
+        } else if (name == "nodes") {
+            opt.nodes = static_cast<int>(number(name, value));
+        } else if (name == "send") {
+            opt.senders.push_back(static_cast<int>(number(name, value)));
+        } else if (name == "config") {
+            int node = -1;
+            auto colon = value.find(':');
+            if (!value.empty() && value.front() != '{' && colon != std::string_view::npos) {
+                node = static_cast<int>(number(name, value.substr(0, colon)));
+                value.remove_prefix(colon + 1);
+            }
+            opt.configs.emplace_back(node, std::string{value});
+        } else if (name == "channel") {
+            opt.channel = static_cast<unsigned int>(number(name, value));
+        } else if (name == "size") {
+            opt.size = static_cast<std::size_t>(number(name, value));
+        } else if (name == "rate") {
+            opt.rate = number(name, value);
+        } else if (name == "duration") {
+            opt.duration = number(name, value);
+        } else if (name == "warmup") {
+            opt.warmup = number(name, value);
+        } else if (name == "settle") {
+            opt.settle = number(name, value);
+        } else if (name == "drain") {
+            opt.drain = number(name, value);
+        } else {
+            throw usage_error{"unknown option --" + std::string{name}};
+        }
+    }
+    if (opt.library.empty()) throw usage_error{"no library given"};
+    if (opt.nodes < 1) throw usage_error{"--nodes must be at least 1"};
+    if (opt.channel >= reserved_channels) throw usage_error{"--channel must be a user channel, below 0xF000"};
+    if (opt.size < sizeof(stamp) || opt.size >= NADI_EXTENDED) throw usage_error{"--size must be at least 24 and below 4 GiB"};
+    if (opt.duration <= 0) throw usage_error{"--duration must be positive"};
+    for (const auto& [node, text] : opt.configs) {
+        if (node >= opt.nodes) throw usage_error{"--config for node " + std::to_string(node) + " of " + std::to_string(opt.nodes)};
+    }
+    for (int node : opt.senders) {
+        if (node >= opt.nodes) throw usage_error{"--send=" + std::to_string(node) + " of " + std::to_string(opt.nodes) + " nodes"};
+    }
+    if (opt.senders.empty()) {
+        for (int node = 0; node < opt.nodes; ++node) opt.senders.push_back(node);
+    }
+    return opt;
+}
+
+// Entry points of the library under test. It is never unloaded, since nodes may free messages
+// late and the harness exits right after.
+struct library {
+    explicit library(const std::string& path) {
+        handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+        if (!handle) throw std::runtime_error{std::string{"cannot load "} + path + ": " + dlerror()};
+        create = reinterpret_cast<decltype(create)>(dlsym(handle, "nadi_create"));
+        create_ex = reinterpret_cast<decltype(create_ex)>(dlsym(handle, "nadi_create_ex"));
+        destroy = reinterpret_cast<decltype(destroy)>(dlsym(handle, "nadi_destroy"));
+        send = reinterpret_cast<decltype(send)>(dlsym(handle, "nadi_send"));
+        auto describe = reinterpret_cast<decltype(&nadi_descriptor)>(dlsym(handle, "nadi_descriptor"));
+        if (!create || !destroy || !send || !describe) throw std::runtime_error{path + " is not a NADI library"};
+
+        std::size_t length = 0;
+        describe(nullptr, &length);
+        std::string text(length, '\0');
+        if (describe(text.data(), &length) != NADI_OK) throw std::runtime_error{"nadi_descriptor of " + path + " failed"};
+        text.resize(length ? length - 1 : 0);
+        descriptor = nlohmann::json::parse(text, nullptr, false);
+        if (!descriptor.is_object()) throw std::runtime_error{"nadi_descriptor of " + path + " is not a JSON object"};
+        auto features = descriptor.value("features", nlohmann::json::array());
+        bool batches = std::find(features.begin(), features.end(), "receive batch") != features.end();
+        if (!batches) create_ex = nullptr;
+    }
+
+    void* handle = nullptr;
+    decltype(&nadi_create) create = nullptr;
+    decltype(&nadi_create_ex) create_ex = nullptr; // nullptr unless the library has "receive batch"
+    decltype(&nadi_destroy) destroy = nullptr;
+    decltype(&nadi_send) send = nullptr;
+    nlohmann::json descriptor;
+};
+
+// Shared with the receive callbacks, which get no context pointer.
+struct measurement {
+    histogram latencies;
+    std::atomic<std::int64_t> begin{std::numeric_limits<std::int64_t>::max()}; // due times measured
+    std::atomic<std::int64_t> end{std::numeric_limits<std::int64_t>::max()};
+    std::atomic<std::uint64_t> received{0};
+
+    std::mutex mutex;
+    std::condition_variable replied;
+    std::vector<nadi_node_handle> nodes; // by index
+    std::size_t replies = 0; // on 0xF100 with a "status"
+    bool failed = false;     // one of them was "error"
+};
+
+measurement state;
+
+bool read_stamp(const nadi_message& message, stamp& out) {
+    std::string_view payload;
+    if (nadi::is_segmented(message)) {
+        auto segments = nadi::segments_of(message);
+        if (segments.empty()) return false;
+        payload = {static_cast<const char*>(segments.front().data), segments.front().length};
+    } else {
+        payload = nadi::payload_view(message);
+    }
+    if (payload.size() < sizeof(stamp)) return false;
+    std::memcpy(&out, payload.data(), sizeof(stamp));
+    return out.magic == stamp_magic;
+}
+
+void reply(const nadi_message& message) {
+    std::string_view text = nadi::payload_view(message);
+    if (!text.empty() && text.back() == '\0') text.remove_suffix(1);
+    auto json = nlohmann::json::parse(text, nullptr, false);
+    {
+        std::lock_guard lock{state.mutex};
+        auto index = std::find(state.nodes.begin(), state.nodes.end(), message.node) - state.nodes.begin();
+        std::fprintf(stderr, "node %td: %.*s\n", index, static_cast<int>(text.size()), text.data());
+        if (!json.is_object() || !json.contains("status")) return;
+        ++state.replies;
+        if (json["status"] == "error") state.failed = true;
+    }
+    state.replied.notify_all();
+}
+
+void handle(nadi_message* message) {
+    std::int64_t arrived = now();
+    if (message->channel == configuration_channel && !nadi::is_segmented(*message)) {
+        reply(*message);
+    } else if (message->channel < reserved_channels) {
+        stamp s;
+        if (read_stamp(*message, s) && s.sent >= state.begin.load(std::memory_order_relaxed) &&
+            s.sent < state.end.load(std::memory_order_relaxed)) {
+            auto latency = static_cast<std::uint64_t>(std::max<std::int64_t>(arrived - s.sent, 0));
+            state.latencies.record(latency);
+            state.received.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    message->free(message);
+}
+
+void receive(nadi_message* message) {
+    handle(message);
+}
+
+void receive_batch(nadi_message** messages, size_t count) {
+    for (size_t i = 0; i < count; ++i) handle(messages[i]);
+}
+
+nadi_message* json_message(const std::string& text) {
+    static const nadi::interned_meta meta = nadi::meta_registry::instance().intern("json");
+    nadi_message* message = nadi::message_pool::instance().allocate(meta, text.size() + 1);
+    std::memcpy(message->data, text.c_str(), text.size() + 1);
+    message->channel = configuration_channel;
+    message->node = 0;
+    return message;
+}
+
+struct sender_counters {
+    std::uint64_t sent = 0; // measured messages the node took
+    std::uint64_t would_block = 0;
+    std::uint64_t errors = 0;
+    nadi_status first_error = NADI_OK;
+};
+
+void wait_until(std::int64_t due) {
+    // sleep_for oversleeps by tens of microseconds, so the last stretch is spun
+    constexpr std::int64_t spin = 100'000;
+    std::int64_t left = due - now();
+    if (left > spin) std::this_thread::sleep_for(std::chrono::nanoseconds{left - spin});
+    while (now() < due) std::this_thread::yield();
+}
+
+// Sends from start until end, at a fixed rate or back to back. Paced messages are stamped with their
+// due time, so a sender held up by a slow node or a late wakeup adds that delay to the latencies
+// of the messages it sends late instead of hiding it (coordinated omission). Sending never waits
+// for replies, so every message yields its own sample. A message retried after NADI_WOULD_BLOCK
+// keeps its stamp, so the time a node makes the sender wait counts as well.
+void drive(const library& lib, nadi_node_handle node, const options& opt, std::int64_t start, std::int64_t begin,
+           std::int64_t end, std::int64_t give_up, sender_counters& counters) {
+    const nadi::interned_meta meta = nadi::meta_registry::instance().intern("nadi_latency");
+    double interval = opt.rate > 0 ? 1e9 / opt.rate : 0;
+    for (std::uint64_t sequence = 0;; ++sequence) {
+        std::int64_t due = 0;
+        if (opt.rate > 0) {
+            due = start + static_cast<std::int64_t>(static_cast<double>(sequence) * interval);
+            if (due >= end) break;
+            wait_until(due);
+        }
+
+        nadi_message* message = nadi::message_pool::instance().allocate(meta, opt.size);
+        message->channel = opt.channel;
+        message->node = 0;
+        auto* data = static_cast<char*>(message->data);
+        std::memset(data + sizeof(stamp), 0, opt.size - sizeof(stamp));
+        stamp s{stamp_magic, sequence, opt.rate > 0 ? due : now()};
+        std::memcpy(data, &s, sizeof(stamp));
+        if (s.sent >= end) {
+            message->free(message);
+            break;
+        }
+
+        nadi_status status = lib.send(message, node);
+        while (status == NADI_WOULD_BLOCK && now() < give_up) {
+            ++counters.would_block;
+            std::this_thread::yield();
+            status = lib.send(message, node);
+        }
+        if (status != NADI_OK) {
+            if (counters.first_error == NADI_OK) counters.first_error = status;
+            ++counters.errors;
+            message->free(message);
+        } else if (s.sent >= begin) {
+            ++counters.sent;
+        }
+    }
+}
+
+double microseconds(std::uint64_t nanoseconds) {
+    return static_cast<double>(nanoseconds) / 1000;
+}
+
+int run(const options& opt) {
+    library lib{opt.library};
+    std::vector<nadi_node_handle> nodes(opt.nodes);
+    for (auto& node : nodes) {
+        nadi_status status = lib.create_ex ? lib.create_ex(&node, receive, receive_batch) : lib.create(&node, receive);
+        if (status != NADI_OK) throw std::runtime_error{"nadi_create failed with " + std::to_string(status)};
+    }
+    {
+        std::lock_guard lock{state.mutex};
+        state.nodes = nodes;
+    }
+    auto destroy_all = [&] {
+        for (auto node : nodes) lib.destroy(node);
+    };
+
+    // Configures all nodes first, since e.g. a listening bridge only confirms once its peer connected
+    std::size_t expected = 0;
+    for (const auto& [index, text] : opt.configs) {
+        for (int i = 0; i < opt.nodes; ++i) {
+            if (index != -1 && index != i) continue;
+            nadi_message* message = json_message(text);
+            nadi_status status = lib.send(message, nodes[i]);
+            if (status != NADI_OK) {
+                message->free(message);
+                destroy_all();
+                throw std::runtime_error{"configuring node " + std::to_string(i) + " failed with " + std::to_string(status)};
+            }
+            ++expected;
+        }
+    }
+    {
+        std::unique_lock lock{state.mutex};
+        state.replied.wait_for(lock, std::chrono::duration<double>{opt.settle}, [&] { return state.failed || state.replies >= expected; });
+        if (state.failed) {
+            lock.unlock();
+            destroy_all();
+            throw std::runtime_error{"a node reported an error while being configured"};
+        }
+    }
+
+    // Senders start together shortly after their threads
+    std::int64_t start = now() + 10'000'000;
+    std::int64_t begin = start + static_cast<std::int64_t>(opt.warmup * 1e9);
+    std::int64_t end = begin + static_cast<std::int64_t>(opt.duration * 1e9);
+    std::int64_t give_up = end + static_cast<std::int64_t>(opt.drain * 1e9);
+    state.begin.store(begin);
+    state.end.store(end);
+    std::vector<sender_counters> counters(opt.senders.size());
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < opt.senders.size(); ++i) {
+        threads.emplace_back(drive, std::cref(lib), nodes[opt.senders[i]], std::cref(opt), start, begin, end, give_up, std::ref(counters[i]));
+    }
+    for (auto& thread : threads) thread.join();
+
+    sender_counters total;
+    for (const auto& c : counters) {
+        total.sent += c.sent;
+        total.would_block += c.would_block;
+        total.errors += c.errors;
+        if (total.first_error == NADI_OK) total.first_error = c.first_error;
+    }
+    while (state.received.load() < total.sent && now() < give_up) std::this_thread::sleep_for(std::chrono::milliseconds{1});
+    destroy_all();
+
+    const histogram& latencies = state.latencies;
+    std::uint64_t received = state.received.load();
+    std::uint64_t lost = total.sent > received ? total.sent - received : 0;
+    double throughput = static_cast<double>(received) / opt.duration;
+    constexpr double percentiles[] = {50, 90, 99, 99.9, 99.99};
+    constexpr const char* percentile_names[] = {"p50", "p90", "p99", "p99.9", "p99.99"};
+    std::string version = lib.descriptor.value("version", "");
+    std::string nadi_version = lib.descriptor.value("nadi version", "");
+
+    if (opt.json) {
+        nlohmann::ordered_json result{
+            {"library", opt.library},
+            {"version", version},
+            {"nadi version", nadi_version},
+            {"nodes", opt.nodes},
+            {"senders", opt.senders.size()},
+            {"channel", opt.channel},
+            {"size", opt.size},
+            {"rate", opt.rate},
+            {"duration", opt.duration},
+            {"sent", total.sent},
+            {"received", received},
+            {"lost", lost},
+            {"would block", total.would_block},
+            {"errors", total.errors},
+            {"throughput", throughput},
+        };
+        nlohmann::ordered_json latency{{"min", microseconds(latencies.min())}};
+        for (std::size_t i = 0; i < std::size(percentiles); ++i) latency[percentile_names[i]] = microseconds(latencies.percentile(percentiles[i]));
+        latency["max"] = microseconds(latencies.max());
+        latency["mean"] = latencies.mean() / 1000;
+        result["latency us"] = latency;
+        std::printf("%s\n", result.dump().c_str());
+    } else {
+        std::printf("library     %s (version %s, nadi %s)\n", opt.library.c_str(), version.c_str(), nadi_version.c_str());
+        std::printf("load        %d nodes, %zu senders, channel %u, %zu B payloads, ", opt.nodes, opt.senders.size(), opt.channel, opt.size);
+        if (opt.rate > 0) {
+            std::printf("%.0f msg/s per sender\n", opt.rate);
+        } else {
+            std::printf("unpaced\n");
+        }
+        std::printf("messages    sent %llu, received %llu, lost %llu, would block %llu, errors %llu",
+                    static_cast<unsigned long long>(total.sent), static_cast<unsigned long long>(received),
+                    static_cast<unsigned long long>(lost), static_cast<unsigned long long>(total.would_block),
+                    static_cast<unsigned long long>(total.errors));
+        if (total.errors) std::printf(" (first %d)", total.first_error);
+        std::printf("\nthroughput  %.1f msg/s over %.1f s\n", throughput, opt.duration);
+        std::printf("latency us  min %.2f", microseconds(latencies.min()));
+        for (std::size_t i = 0; i < std::size(percentiles); ++i) {
+            std::printf("  %s %.2f", percentile_names[i], microseconds(latencies.percentile(percentiles[i])));
+        }
+        std::printf("  max %.2f  mean %.2f\n", microseconds(latencies.max()), latencies.mean() / 1000);
+    }
+    return received ? 0 : 1;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    try {
+        return run(parse(argc, argv));
+    } catch (const usage_error& e) {
+        std::fprintf(stderr, "nadi_latency: %s\n%s", e.what(), usage);
+        return 2;
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "nadi_latency: %s\n", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,78 @@
+// nadi_loopback: NADI node handing every message sent to it straight back through its receive
+// callback, from within nadi_send. Measuring it with nadi_latency gives the overhead of the
+// harness itself, the baseline to subtract when comparing real drivers.
+
+#include <nadi/descriptor_builder.hpp>
+#include <nadi/nadi.h>
+
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+namespace nadi::loopback {
+
+namespace {
+
+constexpr unsigned int reserved_channels = 0xF000;
+
+const descriptor node_descriptor =
+    descriptor_builder{"1.0.0"}
+        .description("Returns every message sent to a channel below 0xF000 on the output channel with the same number, "
+                     "synchronously from within nadi_send and without copying it.")
+        .build();
+
+std::shared_mutex nodes_mutex;
+std::unordered_map<nadi_node_handle, nadi_receive_callback> nodes;
+nadi_node_handle next_handle = 1;
+
+} // namespace
+
+} // namespace nadi::loopback
+
+extern "C" {
+
+DLL_EXPORT nadi_status nadi_create(nadi_node_handle* node, nadi_receive_callback receive_callback) {
+    using namespace nadi::loopback;
+    if (!node || !receive_callback) return NADI_INVALID_MESSAGE;
+    std::lock_guard lock{nodes_mutex};
+    *node = next_handle++;
+    nodes.emplace(*node, receive_callback);
+    return NADI_OK;
+}
+
+DLL_EXPORT nadi_status nadi_destroy(nadi_node_handle node) {
+    using namespace nadi::loopback;
+    std::lock_guard lock{nodes_mutex};
+    return nodes.erase(node) ? NADI_OK : NADI_INVALID_NODE;
+}
+
+DLL_EXPORT nadi_status nadi_send(nadi_message* message, nadi_node_handle node) {
+    using namespace nadi::loopback;
+    if (!message) return NADI_INVALID_MESSAGE;
+    if (message->channel >= reserved_channels) return NADI_INVALID_CHANNEL;
+    nadi_receive_callback receive = nullptr;
+    {
+        std::shared_lock lock{nodes_mutex};
+        auto it = nodes.find(node);
+        if (it == nodes.end()) return NADI_INVALID_NODE;
+        receive = it->second;
+    }
+    // The message is ours now, so it goes back as is with only the sender changed
+    message->node = node;
+    receive(message);
+    return NADI_OK;
+}
+
+DLL_EXPORT void nadi_free(nadi_message* message) {
+    message->free(message);
+}
+
+DLL_EXPORT nadi_status nadi_descriptor(char* buffer, size_t* length) {
+    return nadi::loopback::node_descriptor.write(buffer, length);
+}
+
+DLL_EXPORT nadi_status nadi_descriptor_view(const char** descriptor, size_t* length) {
+    return nadi::loopback::node_descriptor.view(descriptor, length);
+}
+
+} // extern "C"
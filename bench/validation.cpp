@@ -0,0 +1,301 @@
+// Measures the validate_* functions of nadi/message_validation.hpp, both the DOM and the raw text
+// overloads, over one realistic message per type and over large and pathological inputs. Every
+// iteration validates one message, so the reported time is per message; allocs/msg counts calls
+// of the global operator new, plain, aligned and nothrow, during the timed loop. The array forms
+// are not replaced, their default versions forward to these.
+
+#include <nadi/message_validation.hpp>
+#include <benchmark/benchmark.h>
+#include <nlohmann/json.hpp>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::atomic<std::size_t> allocations{0};
+
+void* counted_allocate(std::size_t size, std::size_t alignment) noexcept {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (alignment <= alignof(std::max_align_t)) return std::malloc(size ? size : 1);
+    // aligned_alloc wants a multiple of the alignment
+    return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+// Kept out of line so GCC does not see operator new's result reach std::free and report
+// -Wmismatched-new-delete; both sides of the replacement use the C allocator.
+[[gnu::noinline]] void counted_release(void* p) noexcept {
+    std::free(p);
+}
+
+} // namespace
+
+void* operator new(std::size_t size) {
+    if (void* p = counted_allocate(size, 0)) return p;
+    throw std::bad_alloc{};
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    if (void* p = counted_allocate(size, static_cast<std::size_t>(alignment))) return p;
+    throw std::bad_alloc{};
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return counted_allocate(size, 0);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return counted_allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* p) noexcept {
+    counted_release(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    counted_release(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+    counted_release(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept {
+    counted_release(p);
+}
+
+namespace {
+
+using json_validator = bool (*)(const nlohmann::json&);
+using text_validator = bool (*)(const char*, std::size_t);
+
+struct input {
+    std::string name;
+    std::string text;
+    bool valid;
+    bool text_only = false; // not benchmarked as a DOM, e.g. as it does not parse
+};
+
+struct validator {
+    const char* name;
+    json_validator json;
+    text_validator text;
+    std::vector<input> inputs;
+};
+
+#define NADI_BENCH_VALIDATOR(type, ...) \
+    validator{"validate_" #type, &nadi::validation::validate_##type, &nadi::validation::validate_##type, __VA_ARGS__}
+
+// A discovery reply of a context with many loaded libraries, channels_per_direction inputs and as
+// many outputs each. invalid_tail breaks the number of the very last channel, so a validator has
+// to walk the whole message before it can reject it.
+std::string abstract_nodes_list(int instances, int channels_per_direction, bool invalid_tail = false) {
+    std::string text = R"({"type":"context.abstract_nodes.list","id":"discovery-1","instances":[)";
+    for (int i = 0; i < instances; ++i) {
+        if (i) text += ',';
+        text += R"({"name":"node_)" + std::to_string(i) + R"(","version":"1.1.0","description":"Benchmark node )" +
+                std::to_string(i) + R"( with a description of realistic length","channels":{)";
+        for (std::string direction : {"input", "output"}) {
+            text += (direction == "input" ? "\"" : ",\"") + direction + "\":[";
+            for (int c = 0; c < channels_per_direction; ++c) {
+                if (c) text += ',';
+                bool last = invalid_tail && i == instances - 1 && direction == "output" && c == channels_per_direction - 1;
+                std::string number = last ? '"' + std::to_string(c) + '"' : std::to_string(c);
+                text += R"({"number":)" + number + R"(,"name":")" + direction + '_' + std::to_string(c) +
+                        R"(","data types":["application/json","application/octet-stream"]})";
+            }
+            text += ']';
+        }
+        text += "}}";
+    }
+    return text + "]}";
+}
+
+std::string connections_list(int connections) {
+    std::string text = R"({"type":"context.connections.list","id":"connections-1","connections":[)";
+    for (int i = 0; i < connections; ++i) {
+        if (i) text += ',';
+        text += R"({"source":["node_)" + std::to_string(i) + R"(",1],"target":[)" + std::to_string(i + 1) +
+                R"(,2],"queue":{"capacity":64,"policy":"drop_oldest","dropped":)" + std::to_string(i % 7) + "}}";
+    }
+    return text + "]}";
+}
+
+std::string nodes_list(int nodes) {
+    std::string text = R"({"type":"context.nodes.list","id":"nodes-1","instances":[)";
+    for (int i = 0; i < nodes; ++i) {
+        if (i) text += ',';
+        text += R"({"instance":"instance_)" + std::to_string(i) + "\"}";
+    }
+    return text + "]}";
+}
+
+// An unknown member nested depth levels deep ahead of the members that count, followed by an id
+// of the wrong type.
+std::string deeply_invalid(const std::string& type, int depth) {
+    return R"({"type":")" + type + R"(","extra":)" + std::string(depth, '[') + std::string(depth, ']') + R"(,"id":7})";
+}
+
+std::vector<validator> validators() {
+    std::string large = abstract_nodes_list(500, 16);
+    // The same with "type" moved to the end, which validate_any has to skip everything to find
+    std::string type_last = large;
+    type_last.erase(1, type_last.find(','));
+    type_last.insert(type_last.size() - 1, R"(,"type":"context.abstract_nodes.list")");
+
+    return {
+        NADI_BENCH_VALIDATOR(context_abstract_nodes, {
+            {"valid", R"({"type":"context.abstract_nodes","id":"discovery-1"})", true},
+            {"deeply_invalid", deeply_invalid("context.abstract_nodes", 200), false},
+        }),
+        NADI_BENCH_VALIDATOR(context_abstract_nodes_list, {
+            {"valid", abstract_nodes_list(4, 2), true},
+            {"large", large, true},
+            {"large_type_last", type_last, true},
+            {"large_invalid_tail", abstract_nodes_list(500, 16, true), false},
+            {"large_truncated", large.substr(0, large.size() / 2), false, true},
+            {"deeply_invalid", deeply_invalid("context.abstract_nodes.list", 200), false},
+            // Past the 256 levels json::reader accepts; copying a DOM this deep recurses per level
+            {"too_deep", std::string(400, '[') + std::string(400, ']'), false, true},
+        }),
+        NADI_BENCH_VALIDATOR(context_connect, {
+            {"valid", R"({"type":"context.connect","source":["camera",1],"destination":[7,0],"queue":{"capacity":64,"policy":"drop_oldest"},"id":"c-1"})", true},
+            {"wrong_tuple", R"({"type":"context.connect","source":["camera",1,2],"destination":["display","0"],"id":"c-1"})", false},
+            {"zero_capacity", R"({"type":"context.connect","source":["camera",1],"destination":[7,0],"queue":{"capacity":0,"policy":"latest"}})", false},
+            {"unknown_policy", R"({"type":"context.connect","source":["camera",1],"destination":[7,0],"queue":{"capacity":64,"policy":"spill_to_disk"}})", false},
+        }),
+        NADI_BENCH_VALIDATOR(context_connect_confirm, {
+            {"valid", R"({"type":"context.connect.confirm","status":"success","id":"c-1"})", true},
+        }),
+        NADI_BENCH_VALIDATOR(context_connections, {
+            {"valid", R"({"type":"context.connections","id":"connections-1"})", true},
+        }),
+        NADI_BENCH_VALIDATOR(context_connections_list, {
+            {"valid", connections_list(4), true},
+            {"large", connections_list(1000), true},
+        }),
+        NADI_BENCH_VALIDATOR(context_disconnect, {
+            {"valid", R"({"type":"context.disconnect","source":["camera",1],"destination":[7,0],"id":"d-1"})", true},
+        }),
+        NADI_BENCH_VALIDATOR(context_disconnect_confirm, {
+            {"valid", R"({"type":"context.disconnect.confirm","status":"success","id":"d-1"})", true},
+        }),
+        NADI_BENCH_VALIDATOR(context_node_create, {
+            {"valid", R"({"type":"context.node.create","abstract_name":"nadi_shm","instance_name":"shm_0","affinity":2,"id":"n-1"})", true},
+            {"missing_required", R"({"type":"context.node.create","abstract_name":"nadi_shm","affinity":2,"id":"n-1"})", false},
+        }),
+        NADI_BENCH_VALIDATOR(context_node_create_confirm, {
+            {"valid", R"({"type":"context.node.create.confirm","node":3,"instance_name":"shm_0","id":"n-1"})", true},
+        }),
+        NADI_BENCH_VALIDATOR(context_node_destroy, {
+            {"valid", R"({"type":"context.node.destroy","instance_name":"shm_0","id":"n-2"})", true},
+        }),
+        NADI_BENCH_VALIDATOR(context_node_destroy_confirm, {
+            {"valid", R"({"type":"context.node.destroy.confirm","status":"success","id":"n-2"})", true},
+        }),
+        NADI_BENCH_VALIDATOR(context_nodes, {
+            {"valid", R"({"type":"context.nodes","id":"nodes-1"})", true},
+        }),
+        NADI_BENCH_VALIDATOR(context_nodes_list, {
+            {"valid", nodes_list(4), true},
+            {"large", nodes_list(1000), true},
+        }),
+        NADI_BENCH_VALIDATOR(node_connect, {
+            {"valid", R"({"type":"node.connect","source":[3,1],"target":0,"id":"c-2"})", true},
+        }),
+        NADI_BENCH_VALIDATOR(node_connect_confirm, {
+            {"valid", R"({"type":"node.connect.confirm","status":"success","id":"c-2"})", true},
+        }),
+        NADI_BENCH_VALIDATOR(node_credit, {
+            {"valid", R"({"type":"node.credit","channel":1,"credits":32})", true},
+            {"wrong_type", R"({"type":"node.credit","channel":1,"credits":"32"})", false},
+        }),
+        NADI_BENCH_VALIDATOR(node_disconnect, {
+            {"valid", R"({"type":"node.disconnect","source":[3,1],"target":0,"id":"d-2"})", true},
+        }),
+        NADI_BENCH_VALIDATOR(node_disconnect_confirm, {
+            {"valid", R"({"type":"node.disconnect.confirm","status":"failure","message":"not connected","id":"d-2"})", true},
+        }),
+    };
+}
+
+// Set when an input did not validate as it should, which makes the run fail.
+bool failed = false;
+
+void unexpected(benchmark::State& state) {
+    failed = true;
+    state.SkipWithError("unexpected validation result");
+}
+
+void report(benchmark::State& state, std::size_t allocations_before, std::size_t bytes) {
+    auto counted = allocations.load(std::memory_order_relaxed) - allocations_before;
+    state.counters["allocs/msg"] = benchmark::Counter(static_cast<double>(counted), benchmark::Counter::kAvgIterations);
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * static_cast<std::int64_t>(bytes));
+}
+
+// Registers the text overload and, unless text_only, the DOM overload of validate. The DOM is
+// built once and shared by the registered closures, only validation is timed.
+template <typename Json, typename Text>
+void register_validator(const std::string& name, Json json_validate, Text text_validate, const input& in) {
+    benchmark::RegisterBenchmark((name + "/text/" + in.name).c_str(), [text_validate, in](benchmark::State& state) {
+        if (static_cast<bool>(text_validate(in.text.data(), in.text.size())) != in.valid) {
+            unexpected(state);
+            return;
+        }
+        auto before = allocations.load(std::memory_order_relaxed);
+        for (auto _ : state) {
+            auto result = text_validate(in.text.data(), in.text.size());
+            benchmark::DoNotOptimize(result);
+        }
+        report(state, before, in.text.size());
+    });
+
+    if (in.text_only) return;
+    auto parsed = std::make_shared<const nlohmann::json>(nlohmann::json::parse(in.text));
+    benchmark::RegisterBenchmark((name + "/json/" + in.name).c_str(), [json_validate, parsed, in](benchmark::State& state) {
+        if (static_cast<bool>(json_validate(*parsed)) != in.valid) {
+            unexpected(state);
+            return;
+        }
+        auto before = allocations.load(std::memory_order_relaxed);
+        for (auto _ : state) {
+            auto result = json_validate(*parsed);
+            benchmark::DoNotOptimize(result);
+        }
+        report(state, before, in.text.size());
+    });
+}
+
+bool any_valid(nadi::validation::message_kind kind) {
+    return kind != nadi::validation::message_kind::invalid;
+}
+
+void register_all() {
+    auto any_json = [](const nlohmann::json& msg) { return any_valid(nadi::validation::validate_any(msg)); };
+    auto any_text = [](const char* data, std::size_t length) { return any_valid(nadi::validation::validate_any(data, length)); };
+
+    for (const auto& v : validators()) {
+        for (const auto& in : v.inputs) {
+            register_validator(v.name, v.json, v.text, in);
+            register_validator(std::string{"validate_any/"} + (v.name + sizeof("validate_") - 1), any_json, any_text, in);
+        }
+    }
+    register_validator("validate_any/unknown_type", any_json, any_text,
+                       {"valid", R"({"type":"vendor.telemetry","samples":[1,2,3,4,5,6,7,8],"id":"t-1"})", true});
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    register_all();
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,458 @@
+#!/usr/bin/env python3
+"""Generates nadi/messages.hpp from the message payload schemas in nadi_asyncapi.yaml.
+
+For every entry of components/messages this emits a constexpr nadi::schema table, the
+message_kind enumerator, table-driven validators for parsed and raw JSON, and a typed struct
+with decoders for parsed and raw JSON. Usage: generate_messages.py <nadi_asyncapi.yaml> <output header>
+"""
+
+import sys
+
+import yaml
+
+
+# Keywords that only document a schema
+ANNOTATIONS = {"description", "example", "examples", "title"}
+
+# Keywords understood per type; any other one is an error rather than silently unchecked
+KEYWORDS = {
+    "string": {"type", "const", "enum"},
+    "integer": {"type", "minimum", "maximum"},
+    "array": {"type", "items", "minItems", "maxItems"},
+    "object": {"type", "properties", "required"},
+}
+
+
+def check_keywords(node, supported, where):
+    unknown = set(node) - supported - ANNOTATIONS
+    if unknown:
+        raise SystemExit(f"{where}: unsupported keywords {sorted(unknown)}")
+
+
+class Schema:
+    """Subset of JSON schema used by NADI payloads, mapped onto nadi::schema::value."""
+
+    def __init__(self, node, where):
+        self.where = where
+        self.constant = None
+        self.choices = None
+        self.minimum = None
+        self.maximum = None
+        self.items = None
+        self.tuple = []
+        self.min_items = None
+        self.max_items = None
+        self.properties = []
+        self.required = set()
+        one_of = node.get("oneOf")
+        if one_of is not None:
+            check_keywords(node, {"oneOf"}, where)
+            for alternative in one_of:
+                check_keywords(alternative, {"type"}, f"{where}.oneOf")
+            types = sorted(alternative.get("type") for alternative in one_of)
+            if types != ["integer", "string"]:
+                raise SystemExit(f"{where}: only oneOf string/integer is supported")
+            self.type = "string_or_integer"
+            return
+        self.type = node.get("type")
+        if self.type not in KEYWORDS:
+            raise SystemExit(f"{where}: unsupported type {self.type!r}")
+        check_keywords(node, KEYWORDS[self.type], where)
+        if self.type == "string":
+            self.constant = node.get("const")
+            self.choices = node.get("enum")
+            if self.choices is not None:
+                if self.constant is not None:
+                    raise SystemExit(f"{where}: const and enum exclude each other")
+                if not self.choices or not all(isinstance(choice, str) for choice in self.choices):
+                    raise SystemExit(f"{where}: enum needs a list of strings")
+        elif self.type == "integer":
+            self.minimum = node.get("minimum")
+            self.maximum = node.get("maximum")
+            for bound in (self.minimum, self.maximum):
+                if bound is not None and (type(bound) is not int or not -2**63 <= bound < 2**63):
+                    raise SystemExit(f"{where}: minimum and maximum need 64-bit signed integers")
+        elif self.type == "array":
+            items = node.get("items")
+            if isinstance(items, list):
+                self.tuple = [Schema(item, f"{where}[{i}]") for i, item in enumerate(items)]
+            elif items is not None:
+                self.items = Schema(items, f"{where}[]")
+            self.min_items = node.get("minItems")
+            self.max_items = node.get("maxItems")
+            if self.tuple and (self.min_items != len(self.tuple) or self.max_items != len(self.tuple)):
+                raise SystemExit(f"{where}: tuple arrays need minItems == maxItems == number of items")
+            if not self.tuple and self.items is None:
+                raise SystemExit(f"{where}: arrays need an items schema")
+        elif self.type == "object":
+            for name, child in node.get("properties", {}).items():
+                self.properties.append((name, Schema(child, f"{where}.{name}")))
+            self.required = set(node.get("required", []))
+            unknown = self.required - {name for name, _ in self.properties}
+            if unknown:
+                raise SystemExit(f"{where}: required properties without schema: {sorted(unknown)}")
+            if len(self.properties) > 64:
+                raise SystemExit(f"{where}: at most 64 properties are supported")
+
+    def constraints(self):
+        # extra arguments of the read_json/read_raw overloads checking minimum, maximum or enum
+        if self.choices is not None:
+            return ", {" + ", ".join(cpp_string(choice) for choice in self.choices) + "}"
+        if self.minimum is not None or self.maximum is not None:
+            return f", {cpp_integer(self.minimum, 'INT64_MIN')}, {cpp_integer(self.maximum, 'INT64_MAX')}"
+        return ""
+
+
+def identifier(name):
+    return name.replace(" ", "_").replace(".", "_").replace("-", "_")
+
+
+def cpp_string(text):
+    return '"' + text.replace("\\", "\\\\").replace('"', '\\"') + '"'
+
+
+def cpp_integer(number, default):
+    if number is None:
+        return default
+    # the literal 9223372036854775808 has no signed type, so the lowest value is spelled as a macro
+    return "INT64_MIN" if number == -2**63 else str(number)
+
+
+class Tables:
+    """Emits nadi::schema tables, children before the tables that point at them."""
+
+    def __init__(self):
+        self.lines = []
+
+    def value(self, schema, name):
+        # returns an initializer for schema, emitting named arrays it refers to
+        fields = [f".type = value_type::{schema.type}"]
+        if schema.constant is not None:
+            fields.append(f".constant = {cpp_string(schema.constant)}")
+        if schema.choices is not None:
+            choices = ", ".join(cpp_string(choice) for choice in schema.choices)
+            self.lines.append(f"inline constexpr std::string_view {name}_choices[] = {{{choices}}};")
+            fields.append(f".choices = {name}_choices")
+            fields.append(f".choice_count = {len(schema.choices)}")
+        if schema.minimum is not None:
+            fields.append(f".minimum = {cpp_integer(schema.minimum, '')}")
+        if schema.maximum is not None:
+            fields.append(f".maximum = {cpp_integer(schema.maximum, '')}")
+        if schema.type == "array":
+            if schema.items is not None:
+                self.lines.append(f"inline constexpr value {name}_items{self.value(schema.items, name + '_items')};")
+                fields.append(f".items = &{name}_items")
+            if schema.tuple:
+                elements = [self.value(item, f"{name}_{i}") for i, item in enumerate(schema.tuple)]
+                self.lines.append(f"inline constexpr value {name}_tuple[] = {{{', '.join(elements)}}};")
+                fields.append(f".tuple = {name}_tuple")
+                fields.append(f".tuple_size = {len(schema.tuple)}")
+            if schema.min_items is not None:
+                fields.append(f".min_items = {schema.min_items}")
+            if schema.max_items is not None:
+                fields.append(f".max_items = {schema.max_items}")
+        if schema.type == "object" and schema.properties:
+            entries = []
+            for prop, child in schema.properties:
+                init = self.value(child, f"{name}_{identifier(prop)}")
+                required = ", true" if prop in schema.required else ""
+                entries.append(f"    {{{cpp_string(prop)}, {init}{required}}},")
+            self.lines.append(f"inline constexpr property {name}_properties[] = {{")
+            self.lines.extend(entries)
+            self.lines.append("};")
+            fields.append(f".properties = {name}_properties")
+            fields.append(f".property_count = {len(schema.properties)}")
+        return "{" + ", ".join(fields) + "}"
+
+
+class Structs:
+    """Emits the typed structs and their DOM readers, nested structs first."""
+
+    def __init__(self):
+        self.lines = []
+        self.readers = []
+        self.raw_readers = []
+
+    def member_type(self, schema, name, nested, element=False):
+        if schema.type == "string":
+            return "std::string_view"
+        if schema.type == "integer":
+            return "std::int64_t"
+        if schema.type == "string_or_integer":
+            return "string_or_integer"
+        if schema.type == "array":
+            if schema.tuple:
+                types = [self.member_type(item, f"{name}_{i}", nested, True) for i, item in enumerate(schema.tuple)]
+                template = "std::pair" if len(types) == 2 else "std::tuple"
+                return f"{template}<{', '.join(types)}>"
+            return f"std::vector<{self.member_type(schema.items, name + '_item', nested, True)}>"
+        struct_name = name if element else name + "_type"
+        nested.append((struct_name, schema))
+        return struct_name
+
+    def struct(self, name, schema, qualified, indent=""):
+        nested = []
+        members = []
+        for prop, child in schema.properties:
+            if child.constant is not None:
+                continue
+            member = self.member_type(child, identifier(prop), nested)
+            if prop not in schema.required:
+                member = f"std::optional<{member}>"
+            members.append(f"{indent}    {member} {identifier(prop)};")
+        self.lines.append(f"{indent}struct {name} {{")
+        for nested_name, nested_schema in nested:
+            self.struct(nested_name, nested_schema, f"{qualified}::{nested_name}", indent + "    ")
+        self.lines.extend(members)
+        self.lines.append(f"{indent}}};")
+        self.reader(schema, qualified)
+        self.raw_reader(schema, qualified)
+
+    def read(self, schema, source, target, depth):
+        # statements reading the DOM value source into the lvalue target, returning false on mismatch
+        pad = "    " * depth
+        if schema.type == "object":
+            return [f"{pad}if (!read_json({source}, {target})) return false;"]
+        if schema.type == "array":
+            element = f"element{depth}"
+            if schema.tuple:
+                lines = [f"{pad}if (!{source}.is_array() || {source}.size() != {len(schema.tuple)}) return false;"]
+                for i, item in enumerate(schema.tuple):
+                    get = ("first", "second")[i] if len(schema.tuple) == 2 else None
+                    part = f"{target}.{get}" if get else f"std::get<{i}>({target})"
+                    lines += self.read(item, f"{source}[{i}]", part, depth)
+                return lines
+            bounds = ""
+            if schema.min_items is not None:
+                bounds += f" || {source}.size() < {schema.min_items}"
+            if schema.max_items is not None:
+                bounds += f" || {source}.size() > {schema.max_items}"
+            lines = [f"{pad}if (!{source}.is_array(){bounds}) return false;",
+                     f"{pad}for (const auto& {element} : {source}) {{"]
+            lines += self.read(schema.items, element, f"{target}.emplace_back()", depth + 1)
+            lines.append(f"{pad}}}")
+            return lines
+        if schema.constant is not None:
+            return [f"{pad}if (!read_constant({source}, {cpp_string(schema.constant)})) return false;"]
+        return [f"{pad}if (!read_json({source}, {target}{schema.constraints()})) return false;"]
+
+    def read_raw(self, schema, target, depth):
+        # statements reading the next value of in.reader into the lvalue target
+        pad = "    " * depth
+        if schema.type == "object":
+            return [f"{pad}if (!read_raw(in, {target})) return false;"]
+        if schema.type == "array":
+            first = f"first{depth}"
+            lines = [f"{pad}if (in.reader.peek() != json::value_type::array) return in.fail(decode_error::wrong_type);",
+                     f"{pad}in.reader.begin_array();",
+                     f"{pad}bool {first} = true;"]
+            if schema.tuple:
+                for i, item in enumerate(schema.tuple):
+                    get = ("first", "second")[i] if len(schema.tuple) == 2 else None
+                    part = f"{target}.{get}" if get else f"std::get<{i}>({target})"
+                    lines.append(f"{pad}if (!in.reader.next_element({first})) return in.fail(decode_error::wrong_type);")
+                    lines += self.read_raw(item, part, depth)
+                lines.append(f"{pad}if (in.reader.next_element({first})) return in.fail(decode_error::wrong_type);")
+                lines.append(f"{pad}if (!in.reader.ok()) return false;")
+                return lines
+            lines.append(f"{pad}{target}.clear();")
+            lines.append(f"{pad}while (in.reader.next_element({first})) {{")
+            lines += self.read_raw(schema.items, f"{target}.emplace_back()", depth + 1)
+            lines.append(f"{pad}}}")
+            bounds = []
+            if schema.min_items is not None:
+                bounds.append(f"{target}.size() < {schema.min_items}")
+            if schema.max_items is not None:
+                bounds.append(f"{target}.size() > {schema.max_items}")
+            lines.append(f"{pad}if (!in.reader.ok()) return false;")
+            if bounds:
+                lines.append(f"{pad}if ({' || '.join(bounds)}) return in.fail(decode_error::wrong_type);")
+            return lines
+        if schema.constant is not None:
+            return [f"{pad}if (!read_raw_constant(in, {cpp_string(schema.constant)})) return false;"]
+        return [f"{pad}if (!read_raw(in, {target}{schema.constraints()})) return false;"]
+
+    def raw_reader(self, schema, qualified):
+        lines = [f"inline bool read_raw(raw_source& in, {qualified}& out) {{",
+                 "    if (in.reader.peek() != json::value_type::object) return in.fail(decode_error::wrong_type);",
+                 "    in.reader.begin_object();",
+                 "    std::uint64_t seen = 0;",
+                 "    bool first = true;",
+                 "    std::string_view key;",
+                 "    while (in.reader.next_member(first, key)) {"]
+        required = 0
+        for i, (prop, child) in enumerate(schema.properties):
+            keyword = "if" if i == 0 else "} else if"
+            lines.append(f"        {keyword} (key == {cpp_string(prop)}) {{")
+            if prop in schema.required:
+                required |= 1 << i
+                lines += self.read_raw(child, f"out.{identifier(prop)}", 3)
+                lines.append(f"            seen |= {hex(1 << i)}u;")
+            else:
+                lines.append(f"            auto& value = out.{identifier(prop)}.emplace();")
+                lines += self.read_raw(child, "value", 3)
+        if schema.properties:
+            lines.append("        } else if (!in.reader.skip()) {")
+        else:
+            lines.append("        if (!in.reader.skip()) {")
+        lines.append("            return false;")
+        lines.append("        }")
+        lines.append("    }")
+        lines.append("    if (!in.reader.ok()) return false;")
+        if required:
+            lines.append(f"    if (seen != {hex(required)}u) return in.fail(decode_error::missing_member);")
+        else:
+            lines.append("    (void)seen;")
+        lines.append("    return true;")
+        lines.append("}")
+        self.raw_readers.append("\n".join(lines))
+
+    def reader(self, schema, qualified):
+        lines = [f"inline bool read_json(const nlohmann::json& json, {qualified}& out) {{",
+                 "    if (!json.is_object()) return false;",
+                 "    nlohmann::json::const_iterator it;"]
+        for prop, child in schema.properties:
+            lines.append(f"    it = json.find({cpp_string(prop)});")
+            if prop in schema.required:
+                lines.append("    if (it == json.end()) return false;")
+                lines += self.read(child, "it.value()", f"out.{identifier(prop)}", 1)
+            else:
+                lines.append("    if (it != json.end()) {")
+                lines.append(f"        auto& value = out.{identifier(prop)}.emplace();")
+                lines += self.read(child, "it.value()", "value", 2)
+                lines.append("    }")
+        lines.append("    return true;")
+        lines.append("}")
+        self.readers.append("\n".join(lines))
+
+
+def generate(spec):
+    messages = []
+    for key, message in spec["components"]["messages"].items():
+        payload = Schema(message["payload"], key)
+        type_schema = dict(payload.properties).get("type")
+        if payload.type != "object" or type_schema is None or type_schema.constant is None:
+            raise SystemExit(f"{key}: payload needs a constant \"type\" property")
+        if identifier(type_schema.constant) != key:
+            raise SystemExit(f"{key}: name does not match its type {type_schema.constant!r}")
+        messages.append((type_schema.constant, key, payload))
+    messages.sort()
+
+    tables = Tables()
+    structs = Structs()
+    for _, name, payload in messages:
+        init = tables.value(payload, name)
+        tables.lines.append(f"inline constexpr value {name}{init};")
+        tables.lines.append("")
+        structs.struct(name, payload, name)
+        structs.lines.append("")
+
+    out = []
+    out.append("// Generated by cmake/generate_messages.py from nadi_asyncapi.yaml, do not edit.")
+    out.append("#pragma once")
+    out.append("")
+    for header in ["nadi/hash.hpp", "nadi/message_decoding.hpp", "nadi/message_schema.hpp", "nlohmann/json.hpp"]:
+        out.append(f"#include <{header}>")
+    for header in ["concepts", "cstddef", "cstdint", "optional", "span", "string_view", "tuple", "utility", "vector"]:
+        out.append(f"#include <{header}>")
+    out.append("")
+    out.append("namespace nadi::schema {")
+    out.append("")
+    out.extend(tables.lines)
+    out.append("} // namespace nadi::schema")
+    out.append("")
+    out.append("namespace nadi::validation {")
+    out.append("")
+    out.append("enum class message_kind : std::uint8_t {")
+    out.append("    invalid, // not an object, no string \"type\", or a known type failing its schema")
+    out.append("    unknown, // well-formed message of a type that is not standardized (e.g. \"sensor.config\")")
+    for _, name, _ in messages:
+        out.append(f"    {name},")
+    out.append("};")
+    out.append("")
+    out.append("namespace detail {")
+    out.append("")
+    out.append("inline message_kind kind_of(std::string_view type) {")
+    out.append("    // case labels are distinct hashes, so the compiler rejects any collision between known types")
+    out.append("    switch (fnv1a(type)) {")
+    for type_name, name, _ in messages:
+        out.append(f"    case fnv1a({cpp_string(type_name)}): return type == {cpp_string(type_name)} ? message_kind::{name} : message_kind::unknown;")
+    out.append("    default: return message_kind::unknown;")
+    out.append("    }")
+    out.append("}")
+    out.append("")
+    out.append("inline const schema::value* schema_of(message_kind kind) {")
+    out.append("    switch (kind) {")
+    for _, name, _ in messages:
+        out.append(f"    case message_kind::{name}: return &schema::{name};")
+    out.append("    default: return nullptr;")
+    out.append("    }")
+    out.append("}")
+    out.append("")
+    out.append("} // namespace detail")
+    out.append("")
+    for type_name, name, _ in messages:
+        out.append(f"inline bool validate_{name}(const nlohmann::json& msg) {{")
+        out.append(f"    // Validates {type_name} message")
+        out.append(f"    return schema::check_json(msg, schema::{name});")
+        out.append("}")
+        out.append("")
+        out.append(f"inline bool validate_{name}(const char* data, std::size_t length) {{")
+        out.append(f"    // Validates {type_name} message from raw JSON text")
+        out.append(f"    return schema::check(data, length, schema::{name});")
+        out.append("}")
+        out.append("")
+    out.append("} // namespace nadi::validation")
+    out.append("")
+    out.append("namespace nadi::messages {")
+    out.append("")
+    out.extend(structs.lines)
+    out.append("namespace detail {")
+    out.append("")
+    for reader in structs.readers + structs.raw_readers:
+        out.append(reader)
+        out.append("")
+    out.append("} // namespace detail")
+    out.append("")
+    out.append("// Validates and decodes a parsed message in one pass, string fields are views into json.")
+    out.append("// Only takes nlohmann::json itself, so raw text cannot end up here through a conversion.")
+    out.append("template <class T, class Json>")
+    out.append("    requires std::same_as<Json, nlohmann::json>")
+    out.append("std::optional<T> decode(const Json& json) {")
+    out.append("    T out{};")
+    out.append("    if (!detail::read_json(json, out)) return std::nullopt;")
+    out.append("    return out;")
+    out.append("}")
+    out.append("")
+    out.append("// Validates and decodes raw JSON text, e.g. nadi_message::data, in one pass without a DOM.")
+    out.append("// String fields are views of their still escaped contents inside data.")
+    out.append("template <class T>")
+    out.append("decode_result<T> decode(std::span<const char> data) {")
+    out.append("    detail::raw_source in{json::reader{data.data(), data.size()}};")
+    out.append("    T out{};")
+    out.append("    if (!detail::read_raw(in, out) || !in.reader.finish()) return in.result();")
+    out.append("    return out;")
+    out.append("}")
+    out.append("")
+    out.append("} // namespace nadi::messages")
+    return "\n".join(out) + "\n"
+
+
+def main():
+    if len(sys.argv) != 3:
+        raise SystemExit(__doc__)
+    with open(sys.argv[1], encoding="utf-8") as spec_file:
+        spec = yaml.safe_load(spec_file)
+    text = generate(spec)
+    try:
+        with open(sys.argv[2], encoding="utf-8") as existing:
+            if existing.read() == text:
+                return
+    except FileNotFoundError:
+        pass
+    with open(sys.argv[2], "w", encoding="utf-8") as header:
+        header.write(text)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <nadi/nadi.h>
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string_view>
+
+namespace nadi {
+
+// Reference implementation of the context node (handle 0), provided by the nadi::context library.
+// It creates nodes from NADI libraries registered as abstract nodes and routes every upstream
+// message by the connection table, which is set up through the context.* messages on 0xF000.
+//
+// Routing is lock-free: each message costs one lookup in an immutable, epoch-protected table
+// indexed by (node, channel), and is then posted to the destination node's mailbox, a lock-free
+// queue drained by a pool of work-stealing worker threads. Producers therefore never run, or
+// wait for, the nadi_send of their consumers, and each mailbox is drained by one worker at a
+// time, keeping messages of each connection in order. context.node.create may give an
+// "affinity" hint naming the worker that should preferably run the node. A node answering
+// NADI_WOULD_BLOCK parks its mailbox until it emits a message again, and connections made with a
+// "queue" bound the messages waiting for their destination, the "block" policy being the one
+// case where producers wait for consumers. Commands are executed on a separate control thread,
+// which builds and publishes a new table on every change and sends the responses from the
+// context's 0xF000 output, routed like any other message.
+class context {
+public:
+    // Receives the messages routed to input channels of the context other than 0xF000, e.g. after
+    // connecting [sensor1, 1] to [0, 1]. Takes ownership like nadi_receive_callback and may be
+    // called from any thread. Segmented messages arrive copied into one buffer, which
+    // is an extended message (see nadi::payload_view) from 4 GiB on.
+    using receive_function = std::function<void(nadi_message*)>;
+
+    // worker_count 0 starts one worker per hardware thread.
+    explicit context(receive_function receive = {}, std::size_t worker_count = 0);
+    ~context();
+
+    context(const context&) = delete;
+    context& operator=(const context&) = delete;
+
+    // Loads the NADI library at path, for context.node.create with abstract_name name. Throws
+    // std::runtime_error if it cannot be loaded or the name is taken.
+    void add_abstract_node(std::string_view name, const std::filesystem::path& path);
+
+    // Queues message for the node with the given context handle: 0 delivers to the context itself,
+    // so commands go to channel 0xF000. Ownership passes only on NADI_OK; if the node later rejects
+    // the message (e.g. NADI_INVALID_CHANNEL), it is freed.
+    nadi_status send(nadi_message* message, nadi_node_handle node);
+
+    // Routes message as if emitted by message->node on message->channel, always taking ownership.
+    // Used by the host to feed data into the graph from outputs of the context node.
+    void route(nadi_message* message);
+
+private:
+    struct state;
+    std::unique_ptr<state> state_;
+};
+
+} // namespace nadi
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <nadi/message_pool.hpp>
+#include <nadi/meta_registry.hpp>
+#include <nadi/nadi.h>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+namespace nadi {
+
+// Producer side of the node.credit protocol for one connection: grant() adds the credits of
+// each node.credit received on 0xF100, try_acquire() takes one per message before sending it.
+class credit_counter {
+public:
+    explicit credit_counter(std::int64_t initial = 0) noexcept : credits_{initial} {}
+
+    bool try_acquire(std::int64_t count = 1) noexcept {
+        std::int64_t available = credits_.load(std::memory_order_relaxed);
+        while (available >= count) {
+            if (credits_.compare_exchange_weak(available, available - count, std::memory_order_acquire, std::memory_order_relaxed)) return true;
+        }
+        return false;
+    }
+
+    void grant(std::int64_t count) noexcept { credits_.fetch_add(count, std::memory_order_release); }
+
+    std::int64_t available() const noexcept { return credits_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<std::int64_t> credits_;
+};
+
+// Consumer side: a node.credit message from the 0xF100 output of node, granting credits for
+// its input channel.
+inline nadi_message* make_credit(nadi_node_handle node, unsigned int channel, std::int64_t credits) {
+    static const interned_meta json = meta_registry::instance().intern("json");
+    char text[96];
+    int length = std::snprintf(text, sizeof text, "{\"type\":\"node.credit\",\"channel\":%u,\"credits\":%lld}", channel,
+                               static_cast<long long>(credits));
+    nadi_message* message = message_pool::instance().allocate(json, static_cast<std::size_t>(length) + 1);
+    std::memcpy(message->data, text, static_cast<std::size_t>(length) + 1);
+    message->channel = 0xF100;
+    message->node = node;
+    return message;
+}
+
+} // namespace nadi
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <nadi/nadi.h>
+#include <nlohmann/json.hpp>
+#include <cstddef>
+#include <cstring>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace nadi {
+
+// Serialized nadi_descriptor JSON. Built once, typically into a static at load time, and then
+// handed out by nadi_descriptor as a memcpy and by nadi_descriptor_view as a pointer:
+//
+//   static const nadi::descriptor node_descriptor = nadi::descriptor_builder{"1.0.0"}
+//       .input(0xF100, "configuration", {"json"})
+//       .output(0xF100, "configuration")
+//       .build();
+//
+//   extern "C" DLL_EXPORT nadi_status nadi_descriptor(char* buffer, size_t* length) {
+//       return node_descriptor.write(buffer, length);
+//   }
+//   extern "C" DLL_EXPORT nadi_status nadi_descriptor_view(const char** descriptor, size_t* length) {
+//       return node_descriptor.view(descriptor, length);
+//   }
+class descriptor {
+public:
+    explicit descriptor(std::string json) : json_{std::move(json)} {}
+
+    std::string_view json() const noexcept { return json_; }
+
+    // nadi_descriptor semantics: length is the buffer size in and the string length including the
+    // null terminator out, also when the buffer is too small so the caller can retry once.
+    nadi_status write(char* buffer, std::size_t* length) const noexcept {
+        if (!length) return NADI_INVALID_MESSAGE;
+        std::size_t size = json_.size() + 1;
+        bool fits = buffer && *length >= size;
+        *length = size;
+        if (!fits) return NADI_BUFFER_TOO_SMALL;
+        std::memcpy(buffer, json_.c_str(), size);
+        return NADI_OK;
+    }
+
+    nadi_status view(const char** out, std::size_t* length) const noexcept {
+        if (!out || !length) return NADI_INVALID_MESSAGE;
+        *out = json_.c_str();
+        *length = json_.size() + 1;
+        return NADI_OK;
+    }
+
+private:
+    std::string json_;
+};
+
+// Assembles the fields documented at nadi_descriptor, "nadi version" is always NADI_VERSION.
+class descriptor_builder {
+public:
+    explicit descriptor_builder(std::string_view version) {
+        json_["version"] = version;
+        json_["nadi version"] = NADI_VERSION;
+        json_["channels"] = {{"input", nlohmann::ordered_json::array()}, {"output", nlohmann::ordered_json::array()}};
+    }
+
+    descriptor_builder& description(std::string_view text) {
+        json_["description"] = text;
+        return *this;
+    }
+
+    descriptor_builder& input(unsigned int number, std::string_view name = {}, std::initializer_list<std::string_view> data_types = {},
+                              std::string_view description = {}) {
+        json_["channels"]["input"].push_back(channel(number, name, data_types, description));
+        return *this;
+    }
+
+    descriptor_builder& output(unsigned int number, std::string_view name = {}, std::initializer_list<std::string_view> data_types = {},
+                               std::string_view description = {}) {
+        json_["channels"]["output"].push_back(channel(number, name, data_types, description));
+        return *this;
+    }
+
+    // Optional ABI extension listed in "features", e.g. "send batch".
+    descriptor_builder& feature(std::string_view name) {
+        json_["features"].push_back(name);
+        return *this;
+    }
+
+    // Any other top-level field.
+    descriptor_builder& field(std::string_view key, nlohmann::ordered_json value) {
+        json_[std::string{key}] = std::move(value);
+        return *this;
+    }
+
+    descriptor build() const { return descriptor{json_.dump()}; }
+
+private:
+    static nlohmann::ordered_json channel(unsigned int number, std::string_view name, std::initializer_list<std::string_view> data_types,
+                                          std::string_view description) {
+        nlohmann::ordered_json channel{{"number", number}};
+        if (!name.empty()) channel["name"] = name;
+        if (!description.empty()) channel["description"] = description;
+        if (data_types.size() > 0) {
+            auto& types = channel["data types"] = nlohmann::ordered_json::array();
+            for (auto type : data_types) types.push_back(type);
+        }
+        return channel;
+    }
+
+    nlohmann::ordered_json json_;
+};
+
+} // namespace nadi
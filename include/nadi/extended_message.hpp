@@ -0,0 +1,63 @@
+#pragma once
+
+#include <nadi/nadi.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string_view>
+
+namespace nadi {
+
+inline bool is_extended(const nadi_message& message) noexcept {
+    return message.data_length == NADI_EXTENDED;
+}
+
+// Payload of a message that is not segmented, plain or extended.
+inline std::string_view payload_view(const nadi_message& message) noexcept {
+    if (!is_extended(message)) return {static_cast<const char*>(message.data), message.data_length};
+    const auto* payload = static_cast<const nadi_extended_payload*>(message.data);
+    return {static_cast<const char*>(payload->data), static_cast<std::size_t>(payload->length)};
+}
+
+// Frees the payload of an extended message, e.g. by unmapping it.
+using extended_release = void (*)(void* data, std::uint64_t length, void* owner);
+
+namespace detail {
+
+// One allocation holding the header, the payload descriptor and the meta.
+struct extended_block {
+    nadi_message message;
+    nadi_extended_payload payload;
+    extended_release release;
+    void* owner;
+};
+
+inline void free_extended_block(nadi_message* message) {
+    auto* block = reinterpret_cast<extended_block*>(message);
+    if (block->release) block->release(block->payload.data, block->payload.length, block->owner);
+    block->~extended_block();
+    ::operator delete(block);
+}
+
+} // namespace detail
+
+// Creates an extended message over length bytes at data without copying them, which it passes to
+// release, unless nullptr, when freed. meta is copied; channel and node are left for the caller.
+inline nadi_message* make_extended(std::string_view meta, void* data, std::uint64_t length, extended_release release, void* owner = nullptr) {
+    auto* block = new (::operator new(sizeof(detail::extended_block) + meta.size() + 1)) detail::extended_block{};
+    auto* text = reinterpret_cast<char*>(block + 1);
+    std::memcpy(text, meta.data(), meta.size());
+    text[meta.size()] = '\0';
+    block->payload = {data, length};
+    block->release = release;
+    block->owner = owner;
+    block->message.meta = text;
+    block->message.meta_hash = nadi_meta_hash(text);
+    block->message.data = &block->payload;
+    block->message.data_length = NADI_EXTENDED;
+    block->message.free = detail::free_extended_block;
+    return &block->message;
+}
+
+} // namespace nadi
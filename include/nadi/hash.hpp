@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+namespace nadi {
+
+// 64-bit FNV-1a, usable in constant expressions so hashed strings can be case labels
+constexpr std::uint64_t fnv1a(std::string_view str) noexcept {
+    std::uint64_t hash = 0xcbf29ce484222325ull;
+    for (char c : str) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// nadi_meta_hash of meta, so hashes of known meta strings can be case labels too
+constexpr std::uint64_t meta_hash(std::string_view meta) noexcept {
+    std::uint64_t hash = fnv1a(meta);
+    return hash ? hash : 1;
+}
+
+} // namespace nadi
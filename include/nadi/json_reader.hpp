@@ -0,0 +1,301 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace nadi::json {
+
+enum class value_type : std::uint8_t { none, object, array, string, number, boolean, null };
+
+// Allocation-free pull reader over a JSON text, used to validate and decode messages straight
+// from nadi_message::data without building a DOM. Strings are returned as views of their raw,
+// still escaped contents inside the original buffer. Any syntax error puts the reader into a
+// failed state in which every further call returns false.
+class reader {
+public:
+    reader(const char* data, std::size_t length) noexcept : pos_{data}, end_{data + length} {}
+
+    bool ok() const noexcept { return pos_ != nullptr; }
+
+    // Type of the next value without consuming it, none at the end of input or after an error.
+    value_type peek() noexcept {
+        if (!ok() || !skip_whitespace()) return value_type::none;
+        switch (*pos_) {
+        case '{': return value_type::object;
+        case '[': return value_type::array;
+        case '"': return value_type::string;
+        case 't':
+        case 'f': return value_type::boolean;
+        case 'n': return value_type::null;
+        default: return (*pos_ == '-' || is_digit(*pos_)) ? value_type::number : value_type::none;
+        }
+    }
+
+    bool begin_object() noexcept { return expect('{'); }
+
+    // Advances to the next member of the current object and consumes its key and ':', leaving
+    // the value to be read by the caller. Returns false after the closing '}' or on error.
+    bool next_member(bool& first, std::string_view& key) noexcept {
+        if (!ok() || !skip_whitespace()) return fail();
+        if (*pos_ == '}') {
+            ++pos_;
+            return false;
+        }
+        if (!first && !expect(',')) return false;
+        first = false;
+        return string(key) && expect(':');
+    }
+
+    bool begin_array() noexcept { return expect('['); }
+
+    // Advances to the next element of the current array, returns false after the closing ']' or on error.
+    bool next_element(bool& first) noexcept {
+        if (!ok() || !skip_whitespace()) return fail();
+        if (*pos_ == ']') {
+            ++pos_;
+            return false;
+        }
+        if (!first && !expect(',')) return false;
+        first = false;
+        return true;
+    }
+
+    bool string(std::string_view& out) noexcept {
+        if (!expect('"')) return false;
+        const char* begin = pos_;
+        while (pos_ != end_) {
+            auto c = static_cast<unsigned char>(*pos_);
+            if (c == '"') {
+                out = std::string_view{begin, static_cast<std::size_t>(pos_ - begin)};
+                ++pos_;
+                return true;
+            }
+            if (c < 0x20) return fail();
+            if (c == '\\') {
+                if (!escape()) return false;
+            } else if (c >= 0x80) {
+                if (!utf8()) return false;
+            } else {
+                ++pos_;
+            }
+        }
+        return fail();
+    }
+
+    // Consumes a number without fraction or exponent that fits a 64-bit signed or unsigned
+    // integer, the same values nlohmann::json reports as is_number_integer().
+    bool integer() noexcept {
+        bool negative;
+        std::uint64_t magnitude;
+        return read_integer(negative, magnitude);
+    }
+
+    bool integer(std::int64_t& out) noexcept {
+        bool negative;
+        std::uint64_t magnitude;
+        if (!read_integer(negative, magnitude)) return false;
+        if (magnitude > (negative ? std::uint64_t{1} << 63 : std::uint64_t{INT64_MAX})) return fail();
+        out = negative ? static_cast<std::int64_t>(0 - magnitude) : static_cast<std::int64_t>(magnitude);
+        return true;
+    }
+
+    bool integer(std::uint64_t& out) noexcept {
+        bool negative;
+        if (!read_integer(negative, out)) return false;
+        if (negative && out != 0) return fail();
+        return true;
+    }
+
+    // Consumes and validates one value of any type. Nesting is tracked in a fixed bit stack,
+    // so documents nested deeper than max_depth are rejected rather than allocating.
+    bool skip() noexcept {
+        static constexpr int max_depth = 256;
+        std::uint64_t is_object[max_depth / 64] = {};
+        bool first[max_depth] = {};
+        int depth = 0;
+        do {
+            if (depth > 0) {
+                bool in_object = (is_object[(depth - 1) / 64] >> ((depth - 1) % 64)) & 1;
+                bool more;
+                if (in_object) {
+                    std::string_view key;
+                    more = next_member(first[depth - 1], key);
+                } else {
+                    more = next_element(first[depth - 1]);
+                }
+                if (!ok()) return false;
+                if (!more) {
+                    --depth;
+                    continue;
+                }
+            }
+            switch (peek()) {
+            case value_type::object:
+            case value_type::array: {
+                if (depth == max_depth) return fail();
+                bool object = *pos_ == '{';
+                ++pos_;
+                std::uint64_t bit = std::uint64_t{1} << (depth % 64);
+                is_object[depth / 64] = object ? (is_object[depth / 64] | bit) : (is_object[depth / 64] & ~bit);
+                first[depth] = true;
+                ++depth;
+                break;
+            }
+            case value_type::string: {
+                std::string_view ignored;
+                if (!string(ignored)) return false;
+                break;
+            }
+            case value_type::number:
+                if (!number()) return false;
+                break;
+            case value_type::boolean:
+                if (!literal(*pos_ == 't' ? std::string_view{"true"} : std::string_view{"false"})) return false;
+                break;
+            case value_type::null:
+                if (!literal("null")) return false;
+                break;
+            default:
+                return fail();
+            }
+        } while (depth > 0);
+        return true;
+    }
+
+    // Succeeds if only whitespace remains. Trailing null bytes are accepted, as senders commonly
+    // include the string terminator in nadi_message::data_length.
+    bool finish() noexcept {
+        if (!ok()) return false;
+        while (pos_ != end_ && (is_whitespace(*pos_) || *pos_ == '\0')) ++pos_;
+        return pos_ == end_ || fail();
+    }
+
+private:
+    static constexpr bool is_digit(char c) noexcept { return c >= '0' && c <= '9'; }
+    static constexpr bool is_whitespace(char c) noexcept { return c == ' ' || c == '\n' || c == '\r' || c == '\t'; }
+
+    bool fail() noexcept {
+        pos_ = nullptr;
+        return false;
+    }
+
+    bool skip_whitespace() noexcept {
+        while (pos_ != end_ && is_whitespace(*pos_)) ++pos_;
+        return pos_ != end_;
+    }
+
+    bool expect(char c) noexcept {
+        if (!ok() || !skip_whitespace() || *pos_ != c) return fail();
+        ++pos_;
+        return true;
+    }
+
+    bool literal(std::string_view text) noexcept {
+        if (static_cast<std::size_t>(end_ - pos_) < text.size() || std::string_view{pos_, text.size()} != text) return fail();
+        pos_ += text.size();
+        return true;
+    }
+
+    bool hex4() noexcept {
+        if (end_ - pos_ < 4) return fail();
+        for (int i = 0; i < 4; ++i, ++pos_) {
+            char c = *pos_;
+            if (!is_digit(c) && !(c >= 'a' && c <= 'f') && !(c >= 'A' && c <= 'F')) return fail();
+        }
+        return true;
+    }
+
+    bool escape() noexcept {
+        ++pos_; // backslash
+        if (pos_ == end_) return fail();
+        switch (*pos_++) {
+        case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+            return true;
+        case 'u':
+            return hex4();
+        default:
+            return fail();
+        }
+    }
+
+    bool utf8() noexcept {
+        auto lead = static_cast<unsigned char>(*pos_);
+        int trailing;
+        unsigned char low = 0x80, high = 0xBF; // valid range of the first continuation byte
+        if (lead >= 0xC2 && lead <= 0xDF) {
+            trailing = 1;
+        } else if (lead >= 0xE0 && lead <= 0xEF) {
+            trailing = 2;
+            if (lead == 0xE0) low = 0xA0;
+            if (lead == 0xED) high = 0x9F;
+        } else if (lead >= 0xF0 && lead <= 0xF4) {
+            trailing = 3;
+            if (lead == 0xF0) low = 0x90;
+            if (lead == 0xF4) high = 0x8F;
+        } else {
+            return fail();
+        }
+        if (end_ - pos_ <= trailing) return fail();
+        ++pos_;
+        for (int i = 0; i < trailing; ++i, ++pos_) {
+            auto c = static_cast<unsigned char>(*pos_);
+            if (c < low || c > high) return fail();
+            low = 0x80;
+            high = 0xBF;
+        }
+        return true;
+    }
+
+    // Integer part of a number: -?(0|[1-9][0-9]*), accumulated into magnitude. Returns false
+    // on syntax errors and sets overflow instead of failing when the value exceeds 64 bits.
+    bool integer_part(bool& negative, std::uint64_t& magnitude, bool& overflow) noexcept {
+        if (!ok() || !skip_whitespace()) return fail();
+        negative = *pos_ == '-';
+        if (negative) ++pos_;
+        if (pos_ == end_ || !is_digit(*pos_)) return fail();
+        magnitude = 0;
+        overflow = false;
+        if (*pos_ == '0') {
+            ++pos_;
+            return pos_ == end_ || !is_digit(*pos_) || fail();
+        }
+        for (; pos_ != end_ && is_digit(*pos_); ++pos_) {
+            auto digit = static_cast<std::uint64_t>(*pos_ - '0');
+            if (magnitude > (UINT64_MAX - digit) / 10) overflow = true;
+            magnitude = magnitude * 10 + digit;
+        }
+        return true;
+    }
+
+    bool read_integer(bool& negative, std::uint64_t& magnitude) noexcept {
+        bool overflow;
+        if (!integer_part(negative, magnitude, overflow)) return false;
+        if (pos_ != end_ && (*pos_ == '.' || *pos_ == 'e' || *pos_ == 'E')) return fail();
+        if (overflow || (negative && magnitude > (std::uint64_t{1} << 63))) return fail();
+        return true;
+    }
+
+    bool number() noexcept {
+        bool negative, overflow;
+        std::uint64_t magnitude;
+        if (!integer_part(negative, magnitude, overflow)) return false;
+        if (pos_ != end_ && *pos_ == '.') {
+            ++pos_;
+            if (pos_ == end_ || !is_digit(*pos_)) return fail();
+            while (pos_ != end_ && is_digit(*pos_)) ++pos_;
+        }
+        if (pos_ != end_ && (*pos_ == 'e' || *pos_ == 'E')) {
+            ++pos_;
+            if (pos_ != end_ && (*pos_ == '+' || *pos_ == '-')) ++pos_;
+            if (pos_ == end_ || !is_digit(*pos_)) return fail();
+            while (pos_ != end_ && is_digit(*pos_)) ++pos_;
+        }
+        return true;
+    }
+
+    const char* pos_;
+    const char* end_;
+};
+
+} // namespace nadi::json
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <nadi/json_reader.hpp>
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+
+namespace nadi::messages {
+
+// Field that is either an integer or a string, e.g. a node given by handle or by alias.
+using string_or_integer = std::variant<std::int64_t, std::string_view>;
+
+enum class decode_error : std::uint8_t {
+    syntax,         // not well-formed JSON, or a number where a 64-bit signed integer is expected
+    wrong_type,     // a member, or the message itself, has a different JSON type than the schema
+    wrong_message,  // "type" names a different message
+    missing_member, // a required member is absent
+    wrong_value,    // an integer outside its minimum/maximum, or a string not in its enum
+};
+
+// Result of decoding raw JSON text: the message, or the reason it was rejected. Mirrors the
+// members of std::expected<T, decode_error>, which C++20 does not have.
+template <class T>
+class decode_result {
+public:
+    decode_result(T value) : value_{std::move(value)} {}
+    decode_result(decode_error error) noexcept : error_{error} {}
+
+    bool has_value() const noexcept { return value_.has_value(); }
+    explicit operator bool() const noexcept { return has_value(); }
+
+    T& operator*() noexcept { return *value_; }
+    const T& operator*() const noexcept { return *value_; }
+    T* operator->() noexcept { return &*value_; }
+    const T* operator->() const noexcept { return &*value_; }
+    T& value() { return value_.value(); }
+    const T& value() const { return value_.value(); }
+
+    // Only meaningful without a value.
+    decode_error error() const noexcept { return error_; }
+
+private:
+    std::optional<T> value_;
+    decode_error error_ = decode_error::syntax;
+};
+
+// Readers for the field types of the generated message structs in nadi/messages.hpp. Each one
+// checks the JSON type while reading, so decoding also validates. Strings are views into the DOM.
+namespace detail {
+
+inline bool read_json(const nlohmann::json& json, std::string_view& out) {
+    if (!json.is_string()) return false;
+    out = json.get_ref<const std::string&>();
+    return true;
+}
+
+inline bool read_json(const nlohmann::json& json, std::int64_t& out) {
+    if (!json.is_number_integer()) return false;
+    if (json.is_number_unsigned() && json.get<std::uint64_t>() > std::uint64_t{INT64_MAX}) return false;
+    out = json.get<std::int64_t>();
+    return true;
+}
+
+inline bool read_json(const nlohmann::json& json, string_or_integer& out) {
+    if (json.is_string()) return read_json(json, out.emplace<std::string_view>());
+    return read_json(json, out.emplace<std::int64_t>());
+}
+
+// Integers with a "minimum" or "maximum" and strings with an "enum" in the schema.
+inline bool read_json(const nlohmann::json& json, std::int64_t& out, std::int64_t minimum, std::int64_t maximum) {
+    return read_json(json, out) && out >= minimum && out <= maximum;
+}
+
+inline bool read_json(const nlohmann::json& json, std::string_view& out, std::initializer_list<std::string_view> choices) {
+    return read_json(json, out) && std::find(choices.begin(), choices.end(), out) != choices.end();
+}
+
+inline bool read_constant(const nlohmann::json& json, std::string_view constant) {
+    return json.is_string() && json.get_ref<const std::string&>() == constant;
+}
+
+// Raw counterparts reading straight from the JSON text. String fields are views of the still
+// escaped contents inside the original buffer, so they stay valid as long as that buffer does.
+struct raw_source {
+    json::reader reader;
+    decode_error error = decode_error::wrong_type;
+
+    bool fail(decode_error code) noexcept {
+        error = code;
+        return false;
+    }
+
+    decode_error result() const noexcept { return reader.ok() ? error : decode_error::syntax; }
+};
+
+inline bool read_raw(raw_source& in, std::string_view& out) noexcept {
+    if (in.reader.peek() != json::value_type::string) return in.fail(decode_error::wrong_type);
+    return in.reader.string(out);
+}
+
+inline bool read_raw(raw_source& in, std::int64_t& out) noexcept {
+    if (in.reader.peek() != json::value_type::number) return in.fail(decode_error::wrong_type);
+    return in.reader.integer(out);
+}
+
+inline bool read_raw(raw_source& in, string_or_integer& out) noexcept {
+    if (in.reader.peek() == json::value_type::string) return read_raw(in, out.emplace<std::string_view>());
+    return read_raw(in, out.emplace<std::int64_t>());
+}
+
+inline bool read_raw(raw_source& in, std::int64_t& out, std::int64_t minimum, std::int64_t maximum) noexcept {
+    if (!read_raw(in, out)) return false;
+    return (out >= minimum && out <= maximum) || in.fail(decode_error::wrong_value);
+}
+
+inline bool read_raw(raw_source& in, std::string_view& out, std::initializer_list<std::string_view> choices) noexcept {
+    if (!read_raw(in, out)) return false;
+    return std::find(choices.begin(), choices.end(), out) != choices.end() || in.fail(decode_error::wrong_value);
+}
+
+inline bool read_raw_constant(raw_source& in, std::string_view constant) noexcept {
+    std::string_view value;
+    if (!read_raw(in, value)) return false;
+    return value == constant || in.fail(decode_error::wrong_message);
+}
+
+} // namespace detail
+
+} // namespace nadi::messages
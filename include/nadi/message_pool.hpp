@@ -0,0 +1,199 @@
+#pragma once
+
+#include <nadi/meta_registry.hpp>
+#include <nadi/nadi.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string_view>
+
+namespace nadi {
+
+namespace detail {
+
+struct pool_block {
+    pool_block* next;
+    std::uint32_t size_class;
+};
+
+constexpr std::size_t pool_align(std::size_t size) {
+    constexpr std::size_t alignment = alignof(std::max_align_t);
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+// Layout of a block: pool_block, nadi_message, data, meta (unless interned).
+inline constexpr std::size_t pool_message_offset = pool_align(sizeof(pool_block));
+inline constexpr std::size_t pool_data_offset = pool_message_offset + pool_align(sizeof(nadi_message));
+
+} // namespace detail
+
+// Hands out messages as one contiguous block holding the nadi_message, its data and its meta,
+// so sending costs no allocation in steady state. Blocks come in power of two size classes and
+// are cached per thread; freeing on another thread than the allocating one (the usual case for
+// a message passing the DLL boundary) moves surplus blocks back through a shared list.
+//
+// There is one pool per module (executable or DLL), never destroyed, so messages may be freed
+// from any thread at any time. As free is a function of the allocating module, blocks always
+// return to the pool they came from even when the receiver links its own copy of this header.
+class message_pool {
+public:
+    static constexpr std::size_t min_block_size = 128;
+    static constexpr std::size_t class_count = 10; // up to 64 KiB, larger messages use the heap directly
+
+    static message_pool& instance() {
+        static message_pool* pool = new message_pool{};
+        return *pool;
+    }
+
+    // Returns a message with a null-terminated copy of meta and its meta_hash, data_length bytes of
+    // uninitialized data and free set to message_pool::free. The caller sets channel and node.
+    nadi_message* allocate(std::string_view meta, std::size_t data_length) {
+        nadi_message* message = allocate_block(data_length, meta.size() + 1);
+        auto* meta_copy = static_cast<char*>(message->data) + detail::pool_align(data_length);
+        std::memcpy(meta_copy, meta.data(), meta.size());
+        meta_copy[meta.size()] = '\0';
+        message->meta = meta_copy;
+        message->meta_hash = nadi::meta_hash(meta);
+        return message;
+    }
+
+    // Same with meta pointing at an interned string instead of a copy.
+    nadi_message* allocate(const interned_meta& meta, std::size_t data_length) {
+        nadi_message* message = allocate_block(data_length, 0);
+        meta.apply(*message);
+        return message;
+    }
+
+    // nadi_free_callback of pooled messages.
+    static void free(nadi_message* message) {
+        auto* b = reinterpret_cast<block*>(reinterpret_cast<char*>(message) - detail::pool_message_offset);
+        if (b->size_class < class_count) {
+            instance().push(b);
+        } else {
+            ::operator delete(b);
+        }
+    }
+
+private:
+    using block = detail::pool_block;
+
+    struct shared_list {
+        std::mutex mutex;
+        block* head = nullptr;
+    };
+
+    struct thread_cache {
+        block* head[class_count] = {};
+        std::size_t count[class_count] = {};
+
+        ~thread_cache() {
+            for (std::uint32_t c = 0; c < class_count; ++c) {
+                if (head[c]) instance().give_back(c, head[c], count[c]);
+            }
+        }
+    };
+
+    static constexpr std::size_t slab_size = 256 * 1024;
+    static constexpr std::size_t cache_limit = 64; // blocks per class kept by a thread, half of them are moved on overflow
+
+    message_pool() = default;
+
+    nadi_message* allocate_block(std::size_t data_length, std::size_t meta_size) {
+        if (data_length >= NADI_EXTENDED) throw std::length_error{"nadi message data too long, send it as an extended message"};
+        std::size_t size = detail::pool_data_offset + detail::pool_align(data_length) + meta_size;
+        std::uint32_t size_class = class_of(size);
+        block* b = size_class < class_count ? pop(size_class) : static_cast<block*>(::operator new(size));
+        b->size_class = size_class;
+
+        auto* bytes = reinterpret_cast<char*>(b);
+        auto* message = reinterpret_cast<nadi_message*>(bytes + detail::pool_message_offset);
+        message->data = bytes + detail::pool_data_offset;
+        message->data_length = static_cast<unsigned int>(data_length);
+        message->channel = 0;
+        message->free = &message_pool::free;
+        message->node = 0;
+        return message;
+    }
+
+    static std::uint32_t class_of(std::size_t size) {
+        std::uint32_t c = 0;
+        while (c < class_count && (min_block_size << c) < size) ++c;
+        return c;
+    }
+
+    static thread_cache& cache() {
+        thread_local thread_cache cache;
+        return cache;
+    }
+
+    block* pop(std::uint32_t c) {
+        auto& local = cache();
+        if (!local.head[c]) refill(c, local);
+        block* b = local.head[c];
+        local.head[c] = b->next;
+        --local.count[c];
+        return b;
+    }
+
+    void push(block* b) {
+        auto& local = cache();
+        std::uint32_t c = b->size_class;
+        b->next = local.head[c];
+        local.head[c] = b;
+        if (++local.count[c] <= cache_limit) return;
+
+        // keep the most recently freed half, which is likely still in this core's cache
+        block* last = local.head[c];
+        for (std::size_t i = 1; i < cache_limit / 2; ++i) last = last->next;
+        block* surplus = last->next;
+        last->next = nullptr;
+        give_back(c, surplus, local.count[c] - cache_limit / 2);
+        local.count[c] = cache_limit / 2;
+    }
+
+    void give_back(std::uint32_t c, block* head, std::size_t count) {
+        block* tail = head;
+        for (std::size_t i = 1; i < count; ++i) tail = tail->next;
+        std::lock_guard lock{shared_[c].mutex};
+        tail->next = shared_[c].head;
+        shared_[c].head = head;
+    }
+
+    void refill(std::uint32_t c, thread_cache& local) {
+        {
+            std::lock_guard lock{shared_[c].mutex};
+            block* head = shared_[c].head;
+            if (head) {
+                std::size_t count = 1;
+                block* tail = head;
+                while (count < cache_limit / 2 && tail->next) {
+                    tail = tail->next;
+                    ++count;
+                }
+                shared_[c].head = tail->next;
+                tail->next = nullptr;
+                local.head[c] = head;
+                local.count[c] = count;
+                return;
+            }
+        }
+        // Slabs are never returned to the system, their blocks stay in circulation for the
+        // lifetime of the module.
+        std::size_t block_size = min_block_size << c;
+        std::size_t count = slab_size > block_size ? slab_size / block_size : 1;
+        auto* slab = static_cast<char*>(::operator new(block_size * count));
+        for (std::size_t i = count; i-- > 0;) {
+            auto* b = reinterpret_cast<block*>(slab + i * block_size);
+            b->next = local.head[c];
+            local.head[c] = b;
+        }
+        local.count[c] = count;
+    }
+
+    shared_list shared_[class_count];
+};
+
+} // namespace nadi
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <nadi/json_reader.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace nadi::schema {
+
+enum class value_type : std::uint8_t { string, integer, string_or_integer, array, object };
+
+struct property;
+
+// Constant description of a JSON value, checked by check() directly on the raw text.
+struct value {
+    value_type type;
+    std::string_view constant = {};            // strings: required value, empty for any
+    const std::string_view* choices = nullptr; // strings: allowed values ("enum"), nullptr for any
+    std::size_t choice_count = 0;
+    std::int64_t minimum = INT64_MIN;          // integers: bounds; if set, values outside int64_t fail
+    std::int64_t maximum = INT64_MAX;
+    const value* items = nullptr;              // arrays: schema of elements past the tuple, nullptr for any
+    const value* tuple = nullptr;              // arrays: schemas of the leading elements, in order
+    std::size_t tuple_size = 0;
+    std::size_t min_items = 0;
+    std::size_t max_items = SIZE_MAX;
+    const property* properties = nullptr;      // objects: known members, others are accepted unchecked
+    std::size_t property_count = 0;            // at most 64
+};
+
+struct property {
+    std::string_view name;
+    value schema;
+    bool required = false;
+};
+
+inline bool check(json::reader& reader, const value& schema) noexcept;
+
+namespace detail {
+
+inline bool bounded(const value& schema) noexcept {
+    return schema.minimum != INT64_MIN || schema.maximum != INT64_MAX;
+}
+
+inline bool chosen(std::string_view str, const value& schema) noexcept {
+    if (!schema.choices) return true;
+    for (std::size_t i = 0; i < schema.choice_count; ++i) {
+        if (schema.choices[i] == str) return true;
+    }
+    return false;
+}
+
+inline bool check_array(json::reader& reader, const value& schema) noexcept {
+    if (!reader.begin_array()) return false;
+    std::size_t count = 0;
+    bool first = true;
+    while (reader.next_element(first)) {
+        const value* item = count < schema.tuple_size ? &schema.tuple[count] : schema.items;
+        if (!(item ? check(reader, *item) : reader.skip())) return false;
+        if (++count > schema.max_items) return false;
+    }
+    return reader.ok() && count >= schema.min_items;
+}
+
+inline bool check_object(json::reader& reader, const value& schema) noexcept {
+    if (!reader.begin_object()) return false;
+    std::uint64_t seen = 0;
+    bool first = true;
+    std::string_view key;
+    while (reader.next_member(first, key)) {
+        std::size_t i = 0;
+        while (i < schema.property_count && schema.properties[i].name != key) ++i;
+        if (i == schema.property_count) {
+            if (!reader.skip()) return false;
+            continue;
+        }
+        if (!check(reader, schema.properties[i].schema)) return false;
+        seen |= std::uint64_t{1} << i;
+    }
+    if (!reader.ok()) return false;
+    for (std::size_t i = 0; i < schema.property_count; ++i) {
+        if (schema.properties[i].required && !(seen & (std::uint64_t{1} << i))) return false;
+    }
+    return true;
+}
+
+} // namespace detail
+
+// Consumes one value from reader and returns whether it matches schema. Keys, string constants
+// and choices are compared against the raw text, so escaped spellings of them do not match.
+inline bool check(json::reader& reader, const value& schema) noexcept {
+    switch (schema.type) {
+    case value_type::string: {
+        std::string_view str;
+        return reader.peek() == json::value_type::string && reader.string(str) &&
+               (schema.constant.empty() || str == schema.constant) && detail::chosen(str, schema);
+    }
+    case value_type::integer: {
+        if (reader.peek() != json::value_type::number) return false;
+        if (!detail::bounded(schema)) return reader.integer();
+        std::int64_t number;
+        return reader.integer(number) && number >= schema.minimum && number <= schema.maximum;
+    }
+    case value_type::string_or_integer: {
+        auto type = reader.peek();
+        std::string_view str;
+        return type == json::value_type::string ? reader.string(str) : type == json::value_type::number && reader.integer();
+    }
+    case value_type::array:
+        return reader.peek() == json::value_type::array && detail::check_array(reader, schema);
+    case value_type::object:
+        return reader.peek() == json::value_type::object && detail::check_object(reader, schema);
+    }
+    return false;
+}
+
+// Checks a complete JSON text, e.g. nadi_message::data, against schema without allocating.
+inline bool check(const char* data, std::size_t length, const value& schema) noexcept {
+    json::reader reader{data, length};
+    return check(reader, schema) && reader.finish();
+}
+
+// Same checks on an already parsed nlohmann::json style DOM.
+template <class Json>
+bool check_json(const Json& json, const value& schema) {
+    switch (schema.type) {
+    case value_type::string: {
+        if (!json.is_string()) return false;
+        std::string_view str = json.template get_ref<const typename Json::string_t&>();
+        return (schema.constant.empty() || str == schema.constant) && detail::chosen(str, schema);
+    }
+    case value_type::integer:
+        if (!json.is_number_integer()) return false;
+        if (!detail::bounded(schema)) return true;
+        if (json.is_number_unsigned() && json.template get<std::uint64_t>() > std::uint64_t{INT64_MAX}) return false;
+        return json.template get<std::int64_t>() >= schema.minimum && json.template get<std::int64_t>() <= schema.maximum;
+    case value_type::string_or_integer:
+        return json.is_string() || json.is_number_integer();
+    case value_type::array: {
+        if (!json.is_array() || json.size() < schema.min_items || json.size() > schema.max_items) return false;
+        std::size_t index = 0;
+        for (const auto& element : json) {
+            const value* item = index < schema.tuple_size ? &schema.tuple[index] : schema.items;
+            if (item && !check_json(element, *item)) return false;
+            ++index;
+        }
+        return true;
+    }
+    case value_type::object:
+        if (!json.is_object()) return false;
+        for (std::size_t i = 0; i < schema.property_count; ++i) {
+            const auto& property = schema.properties[i];
+            auto it = json.find(property.name);
+            if (it == json.end()) {
+                if (property.required) return false;
+            } else if (!check_json(*it, property.schema)) {
+                return false;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+} // namespace nadi::schema
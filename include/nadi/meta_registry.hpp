@@ -0,0 +1,68 @@
+#pragma once
+
+#include <nadi/hash.hpp>
+#include <nadi/nadi.h>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace nadi {
+
+// Immutable meta string shared by all messages of a stream, together with its meta_hash.
+struct interned_meta {
+    const char* meta = nullptr;
+    std::uint64_t hash = 0;
+
+    // Points message at the interned string, which must then not be freed by message->free.
+    void apply(nadi_message& message) const noexcept {
+        message.meta = meta;
+        message.meta_hash = hash;
+    }
+};
+
+// Interning table for meta strings. Interned strings are never freed, so senders intern the
+// meta of a stream once and put the same pointer and hash into every message without
+// allocating, and receivers dispatch on meta_hash, e.g. `case nadi::meta_hash("json"):`.
+// Like message_pool there is one never-destroyed registry per module.
+class meta_registry {
+public:
+    static meta_registry& instance() {
+        static meta_registry* registry = new meta_registry{};
+        return *registry;
+    }
+
+    interned_meta intern(std::string_view meta) {
+        {
+            std::shared_lock lock{mutex_};
+            if (auto it = by_meta_.find(meta); it != by_meta_.end()) return it->second;
+        }
+        std::unique_lock lock{mutex_};
+        if (auto it = by_meta_.find(meta); it != by_meta_.end()) return it->second;
+        const std::string& stored = storage_.emplace_back(meta);
+        interned_meta interned{stored.c_str(), meta_hash(stored)};
+        by_meta_.emplace(stored, interned);
+        by_hash_.emplace(interned.hash, interned.meta); // keeps the first string on the (unlikely) collision
+        return interned;
+    }
+
+    // Interned meta string with the given hash, nullptr if none was interned in this module.
+    const char* find(std::uint64_t hash) const {
+        std::shared_lock lock{mutex_};
+        auto it = by_hash_.find(hash);
+        return it == by_hash_.end() ? nullptr : it->second;
+    }
+
+private:
+    meta_registry() = default;
+
+    mutable std::shared_mutex mutex_;
+    std::deque<std::string> storage_; // deque never moves its elements, so views and c_str() stay valid
+    std::unordered_map<std::string_view, interned_meta> by_meta_;
+    std::unordered_map<std::uint64_t, const char*> by_hash_;
+};
+
+} // namespace nadi
@@ -17,12 +17,19 @@
 #include <stddef.h>
 #include <stdint.h>
 
+/** NADI interface version implemented by this header, reported as "nadi version" by nadi_descriptor. */
+#define NADI_VERSION "1.1.0"
+
 #ifdef _WIN32
 #define DLL_EXPORT __declspec(dllexport)
 #else
 #define DLL_EXPORT
 #endif
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -37,7 +44,8 @@ typedef enum {
     NADI_INVALID_MESSAGE = -2, /**< Invalid or malformed message. */
     NADI_NOT_INITIALIZED = -3, /**< Node not created. */
     NADI_INVALID_CHANNEL = -4, /**< Invalid channel for the receiver node. */
-    NADI_BUFFER_TOO_SMALL = -5 /**< Provided buffer is too small for descriptor. */
+    NADI_BUFFER_TOO_SMALL = -5,/**< Provided buffer is too small for descriptor. */
+    NADI_WOULD_BLOCK = -6      /**< Receiver cannot accept the message now, retry later (see node.credit for backpressure). */
 } nadi_status;
 
 /** Forward declaration for message struct. */
@@ -45,6 +53,8 @@ struct nadi_message;
 
 /** Callback for receiving upstream messages from downstream nodes. Always calls msg->free. Errors should be handled internally (e.g., logging). */
 typedef void(*nadi_receive_callback)(struct nadi_message*);
+/** Callback for receiving several upstream messages at once, registered with nadi_create_ex. Calls free on each of the count messages; the array itself stays owned by the node and is only valid during the call. */
+typedef void(*nadi_receive_batch_callback)(struct nadi_message** messages, size_t count);
 /** Callback for freeing message resources, called by nadi_send (on success) or nadi_receive_callback. Must not be NULL. */
 typedef void(*nadi_free_callback)(struct nadi_message*);
 
@@ -55,14 +65,120 @@ typedef void(*nadi_free_callback)(struct nadi_message*);
  */
 struct nadi_message {
     const char* meta;        /**< Null-terminated JSON string, allocated by sender, freed by nadi_send (on success) or nadi_receive_callback. */
-    uint64_t meta_hash;      /**< Hash of meta for quick comparison, 0 is unused. */
+    uint64_t meta_hash;      /**< nadi_meta_hash of meta for quick comparison, or 0 if the sender did not compute it. */
     void* data;              /**< Raw bytes, allocated by sender, freed by nadi_send (on success) or nadi_receive_callback. */
-    unsigned int data_length;/**< Length of data in bytes. */
+    unsigned int data_length;/**< Length of data in bytes, below NADI_EXTENDED, or NADI_EXTENDED if data points to a nadi_extended_payload, or NADI_SEGMENTED if data points to a nadi_segments. */
     unsigned int channel;    /**< Channel number for multiplexing streams. Most nodes reserve 0xF100 for a "configuration" channel (input/output) and may support 0xF000 for a "configure context" output channel. The context node (handle 0) uses 0xF000 as an input channel for commands. Channels above 0xF000 are reserved for future standardization; user-defined channels must be 0 to 0xF000. */
     nadi_free_callback free; /**< Non-NULL callback to free meta and data, set to nadi_free for upstream messages. */
     nadi_node_handle node;   /**< Sender's node identifier. */
 };
 
+/**
+ * Standard hash of a meta string for nadi_message::meta_hash: 64-bit FNV-1a over its bytes without the
+ * null terminator, with 0 replaced by 1 since 0 marks an unset hash. Senders compute it once per stream,
+ * receivers dispatch on it instead of comparing meta. Identical meta strings always have identical hashes.
+ */
+static inline uint64_t nadi_meta_hash(const char* meta) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (; *meta; ++meta) {
+        hash ^= (unsigned char)*meta;
+        hash *= 0x100000001b3ull;
+    }
+    return hash ? hash : 1;
+}
+
+/**
+ * Reference count shared by all deliveries of one message payload, see nadi_shared_message.
+ * Allocated by whoever shares the payload (usually the context), which also chooses destroy.
+ */
+struct nadi_message_share {
+    volatile int32_t refcount; /**< Outstanding references, only changed through nadi_message_retain and nadi_message_release. */
+    void (*destroy)(struct nadi_message_share* share); /**< Called once the last reference is released, frees the payload and this share. */
+};
+
+/**
+ * Message header delivering a shared payload, so one message reaches several receivers without copying meta or data.
+ * Each header holds one reference to share; meta and data stay valid until the last reference is released.
+ * Its free callback must call nadi_message_release and then free the header itself.
+ * Nodes listing "shared messages" in the "features" of their nadi_descriptor receive every message the context passes
+ * to their nadi_send as a nadi_shared_message, fan-out and single deliveries alike, and may call nadi_message_retain
+ * on it to hand the payload on without copying. Other nodes get plain nadi_message headers and must not assume any.
+ */
+struct nadi_shared_message {
+    struct nadi_message message;       /**< Must be first, a nadi_shared_message* is passed wherever a nadi_message* is expected. */
+    struct nadi_message_share* share;  /**< Shared reference count of the payload. */
+};
+
+/** Takes an additional reference to the payload of message, to be released by nadi_message_release. */
+static inline void nadi_message_retain(struct nadi_shared_message* message) {
+#if defined(_MSC_VER)
+    _InterlockedIncrement((volatile long*)&message->share->refcount);
+#else
+    __atomic_add_fetch(&message->share->refcount, 1, __ATOMIC_RELAXED);
+#endif
+}
+
+/** Releases one reference to the payload of message, destroying the payload with the last one. Does not free the header. */
+static inline void nadi_message_release(struct nadi_shared_message* message) {
+    struct nadi_message_share* share = message->share;
+    int32_t remaining;
+#if defined(_MSC_VER)
+    remaining = _InterlockedDecrement((volatile long*)&share->refcount);
+#else
+    remaining = __atomic_sub_fetch(&share->refcount, 1, __ATOMIC_ACQ_REL);
+#endif
+    if (remaining == 0) {
+        share->destroy(share);
+    }
+}
+
+/** nadi_message::data_length of an extended message, whose data points to a nadi_extended_payload instead of the payload. */
+#define NADI_EXTENDED 0xFFFFFFFEu
+
+/**
+ * Payload of an extended message: one contiguous buffer with a 64-bit length, for payloads that do not fit
+ * nadi_message::data_length, e.g. a whole memory-mapped capture passed on without copying or splitting it.
+ * The message's free callback releases data and this struct. Since NADI 1.1.0: nodes listing "extended messages" in the
+ * "features" of their nadi_descriptor accept extended messages through nadi_send. Others must only get plain ones:
+ * a context delivering to them copies payloads below NADI_EXTENDED bytes into one buffer and drops larger ones.
+ */
+struct nadi_extended_payload {
+    void* data;      /**< Bytes of the payload. */
+    uint64_t length; /**< Length of data in bytes, may be NADI_EXTENDED or more. */
+};
+
+/** nadi_message::data_length of a segmented message, whose data points to a nadi_segments instead of the payload. */
+#define NADI_SEGMENTED 0xFFFFFFFFu
+
+/** One contiguous part of a segmented message's payload. */
+struct nadi_segment {
+    void* data;                                  /**< Bytes of this segment. */
+    size_t length;                               /**< Length of data in bytes. */
+    void (*free)(struct nadi_segment* segment);  /**< Releases data when the message is freed, or NULL if data needs no release of its own. */
+    void* owner;                                 /**< Free for use by whoever set free, e.g. the buffer pool data came from. */
+};
+
+/**
+ * Payload of a segmented message: the concatenation of count segments, in order, so producers assembling e.g. a
+ * header, a sample block and a trailer from separate buffers need not copy them into one.
+ * The message's free callback releases every segment by calling its free (see nadi_segments_release) and then the
+ * list itself. Segments are immutable like any payload; consumers iterate them or write them out with writev.
+ * Nodes listing "segmented messages" in the "features" of their nadi_descriptor accept segmented messages through
+ * nadi_send. Others must only get contiguous ones: a context delivering to them copies the segments into one buffer.
+ */
+struct nadi_segments {
+    struct nadi_segment* segments; /**< Array of count segments. */
+    size_t count;                  /**< Number of segments. */
+};
+
+/** Calls the free callback of every segment that has one, for use in the free callback of segmented messages. */
+static inline void nadi_segments_release(struct nadi_segments* segments) {
+    size_t i;
+    for (i = 0; i < segments->count; ++i) {
+        if (segments->segments[i].free) segments->segments[i].free(&segments->segments[i]);
+    }
+}
+
 /**
  * Creates a node with a callback for receiving upstream messages.
  * @param node Output parameter for the node identifier.
@@ -71,6 +187,18 @@ struct nadi_message {
  */
 DLL_EXPORT nadi_status nadi_create(nadi_node_handle* node, nadi_receive_callback receive_callback);
 
+/**
+ * Creates a node like nadi_create, additionally registering a callback for receiving upstream messages in batches.
+ * The node may then deliver any number of upstream messages through either callback, in order, e.g. flushing its
+ * internal queue with a single receive_batch_callback call instead of one receive_callback call per message.
+ * Optional: only exported by nodes listing "receive batch" in the "features" of their nadi_descriptor; use nadi_create otherwise.
+ * @param node Output parameter for the node identifier.
+ * @param receive_callback Function to handle single upstream messages, or NULL if not receiving.
+ * @param receive_batch_callback Function to handle batches of upstream messages, or NULL to receive every message through receive_callback.
+ * @return NADI_OK on success, or an error code.
+ */
+DLL_EXPORT nadi_status nadi_create_ex(nadi_node_handle* node, nadi_receive_callback receive_callback, nadi_receive_batch_callback receive_batch_callback);
+
 /**
  * Destroys a node, freeing resources.
  * @param node The node identifier to destroy.
@@ -84,6 +212,8 @@ DLL_EXPORT nadi_status nadi_destroy(nadi_node_handle node);
  * Assumes message->node (sender) is set correctly by the caller; incorrect values may cause undefined behavior.
  * On success, the message's nadi_free_callback (never NULL) is called when done.
  * On failure (including NADI_INVALID_CHANNEL), the caller retains ownership and must free the message.
+ * NADI_WOULD_BLOCK means the receiver is temporarily full: the caller retains ownership and may retry later. A receiver
+ * returning it must send a message from its 0xF100 output (normally node.credit) once it can accept again.
  * The caller must not access or free the message after a successful call.
  * The sender's node is identified by message->node, and the receiver by the node parameter.
  * @param message The message to send.
@@ -92,6 +222,25 @@ DLL_EXPORT nadi_status nadi_destroy(nadi_node_handle node);
  */
 DLL_EXPORT nadi_status nadi_send(struct nadi_message* message, nadi_node_handle node);
 
+/**
+ * Sends several downstream messages to the same receiver node in one call, so the receiver can amortize
+ * channel lookup, locking and wakeups across the batch. Optional: only exported by nodes listing "send batch"
+ * in the "features" of their nadi_descriptor; for other nodes call nadi_send once per message.
+ * Each message is handled as by nadi_send, in order: ownership of messages[i] passes to the receiver only if
+ * statuses[i] is NADI_OK, otherwise the caller retains ownership and must free it, or retry it if NADI_WOULD_BLOCK.
+ * A receiver returning NADI_WOULD_BLOCK for a message should stop there, so retries keep the order.
+ * A receiver may stop early (e.g., when out of buffer space); messages after the last one it looked at
+ * are not sent and get no status written, their count is count - *accepted for the caller to retry later.
+ * @param messages Array of count messages to send.
+ * @param count Number of messages.
+ * @param node The receiver's node identifier.
+ * @param statuses Output array of count status codes, one per message looked at.
+ * @param accepted Output for the number of messages looked at, a prefix of messages.
+ * @return NADI_OK if every message was sent, the status of the first failed message otherwise,
+ *         or an error code (e.g., NADI_INVALID_NODE) with *accepted set to 0 if none were looked at.
+ */
+DLL_EXPORT nadi_status nadi_send_batch(struct nadi_message** messages, size_t count, nadi_node_handle node, nadi_status* statuses, size_t* accepted);
+
 /**
  * Frees a message and its resources.
  * Used as the nadi_free_callback for upstream messages passed to nadi_receive_callback,
@@ -106,9 +255,12 @@ DLL_EXPORT void nadi_free(struct nadi_message* message);
  * The length parameter is updated to the actual length of the JSON string (including null terminator).
  * The JSON includes:
  * - "version": Node-specific version (string).
- * - "nadi version": NADI interface version in semantic versioning format (e.g., "1.0.0").
+ * - "nadi version": NADI interface version in semantic versioning format (e.g., "1.1.0").
  * - "channels": Object with "input" and "output" arrays of channel descriptions.
  * - Optional fields like "description" (unconstrained, human-readable node description).
+ * - Optional "features": Array of optional ABI extensions the node supports (strings), e.g. "shared messages" (see nadi_shared_message),
+ *   "send batch" (see nadi_send_batch), "receive batch" (see nadi_create_ex), "segmented messages" (see nadi_segments)
+ *   or "extended messages" (see nadi_extended_payload).
  * - Additional top-level fields may be included, with future fields to be standardized.
  * Each channel description has:
  * - "number": Channel number (integer, e.g., 61712 for 0xF100, 61440 for 0xF000).
@@ -121,7 +273,7 @@ DLL_EXPORT void nadi_free(struct nadi_message* message);
  * Channels above 0xF000 are reserved for future standardization; user-defined channels must be 0 to 0xF000.
  * Example for a sensor node: {
  *   "version": "1.0.0",
- *   "nadi version": "1.0.0",
+ *   "nadi version": "1.1.0",
  *   "description": "Temperature sensor node",
  *   "channels": {
  *     "input": [
@@ -140,6 +292,16 @@ DLL_EXPORT void nadi_free(struct nadi_message* message);
  */
 DLL_EXPORT nadi_status nadi_descriptor(char* buffer, size_t* length);
 
+/**
+ * Returns the JSON string written by nadi_descriptor without copying it, for enumerating many nodes cheaply.
+ * The string is immutable, null-terminated and stays valid until the library is unloaded.
+ * Optional: callers look up the symbol and fall back to nadi_descriptor if the library does not export it.
+ * @param descriptor Output for a pointer to the JSON string.
+ * @param length Output for the length of the JSON string (including null terminator), as reported by nadi_descriptor.
+ * @return NADI_OK on success, or an error code.
+ */
+DLL_EXPORT nadi_status nadi_descriptor_view(const char** descriptor, size_t* length);
+
 #ifdef __cplusplus
 }
 #endif
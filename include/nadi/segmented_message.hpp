@@ -0,0 +1,119 @@
+#pragma once
+
+#include <nadi/extended_message.hpp>
+#include <nadi/message_pool.hpp>
+#include <nadi/nadi.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <span>
+#include <string_view>
+
+namespace nadi {
+
+inline bool is_segmented(const nadi_message& message) noexcept {
+    return message.data_length == NADI_SEGMENTED;
+}
+
+// Segments of a segmented message.
+inline std::span<const nadi_segment> segments_of(const nadi_message& message) noexcept {
+    const auto* list = static_cast<const nadi_segments*>(message.data);
+    return {list->segments, list->count};
+}
+
+// Payload length of any message, the sum of its segments for segmented ones.
+inline std::uint64_t payload_length(const nadi_message& message) noexcept {
+    if (!is_segmented(message)) return payload_view(message).size();
+    std::uint64_t length = 0;
+    for (const auto& segment : segments_of(message)) length += segment.length;
+    return length;
+}
+
+// Copies the payload of any message to destination, which holds payload_length(message) bytes.
+inline void copy_payload(const nadi_message& message, void* destination) noexcept {
+    auto* out = static_cast<std::byte*>(destination);
+    if (!is_segmented(message)) {
+        auto payload = payload_view(message);
+        if (!payload.empty()) std::memcpy(out, payload.data(), payload.size());
+        return;
+    }
+    for (const auto& segment : segments_of(message)) {
+        if (segment.length > 0) std::memcpy(out, segment.data, segment.length);
+        out += segment.length;
+    }
+}
+
+namespace detail {
+
+inline void delete_payload(void* data, std::uint64_t, void*) {
+    ::operator delete(data);
+}
+
+} // namespace detail
+
+// Takes ownership of message and returns it with a contiguous payload, for receivers without
+// "segmented messages", and with a plain one unless extended is set, for receivers without
+// "extended messages". Other messages are copied into a new one and freed; nullptr if the payload is too
+// large for the receiver, in which case message is freed as well.
+inline nadi_message* flatten(nadi_message* message, bool extended = false) {
+    if (!is_segmented(*message) && (extended || !is_extended(*message))) return message;
+    std::uint64_t length = payload_length(*message);
+    const char* meta = message->meta ? message->meta : "";
+    nadi_message* flat = nullptr;
+    if (length < NADI_EXTENDED) {
+        flat = message_pool::instance().allocate(meta, static_cast<std::size_t>(length));
+        copy_payload(*message, flat->data);
+    } else if (extended && length <= SIZE_MAX) {
+        void* data = ::operator new(static_cast<std::size_t>(length), std::nothrow);
+        if (data) {
+            copy_payload(*message, data);
+            flat = make_extended(meta, data, length, detail::delete_payload);
+        }
+    }
+    if (flat) {
+        flat->meta_hash = message->meta_hash;
+        flat->channel = message->channel;
+        flat->node = message->node;
+    }
+    message->free(message);
+    return flat;
+}
+
+namespace detail {
+
+// One allocation holding the header, the segment list and the meta.
+struct segmented_block {
+    nadi_message message;
+    nadi_segments list;
+};
+
+inline void free_segmented_block(nadi_message* message) {
+    auto* block = reinterpret_cast<segmented_block*>(message);
+    nadi_segments_release(&block->list);
+    block->~segmented_block();
+    ::operator delete(block);
+}
+
+} // namespace detail
+
+// Creates a segmented message over the given segments, which it releases through their free
+// callbacks when freed. meta is copied; channel and node are left for the caller.
+inline nadi_message* make_segmented(std::string_view meta, std::span<const nadi_segment> segments) {
+    std::size_t size = sizeof(detail::segmented_block) + segments.size() * sizeof(nadi_segment) + meta.size() + 1;
+    auto* block = new (::operator new(size)) detail::segmented_block{};
+    auto* copies = reinterpret_cast<nadi_segment*>(block + 1);
+    auto* text = reinterpret_cast<char*>(copies + segments.size());
+    std::memcpy(copies, segments.data(), segments.size() * sizeof(nadi_segment));
+    std::memcpy(text, meta.data(), meta.size());
+    text[meta.size()] = '\0';
+    block->list = {copies, segments.size()};
+    block->message.meta = text;
+    block->message.meta_hash = nadi_meta_hash(text);
+    block->message.data = &block->list;
+    block->message.data_length = NADI_SEGMENTED;
+    block->message.free = detail::free_segmented_block;
+    return &block->message;
+}
+
+} // namespace nadi
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <nadi/nadi.h>
+#include <cstddef>
+
+namespace nadi {
+
+// Completes nadi_send_batch for a node that looked at the first looked_at messages and wrote their
+// statuses: reports them through accepted and returns the status of the first message not sent,
+// NADI_OK if all were. A node refusing a message with NADI_WOULD_BLOCK stops right after it.
+inline nadi_status batch_status(const nadi_status* statuses, std::size_t looked_at, std::size_t* accepted) noexcept {
+    *accepted = looked_at;
+    for (std::size_t i = 0; i < looked_at; ++i) {
+        if (statuses[i] != NADI_OK) return statuses[i];
+    }
+    return NADI_OK;
+}
+
+} // namespace nadi
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <nadi/nadi.h>
+#include <cstddef>
+#include <cstdint>
+
+namespace nadi {
+
+namespace detail {
+
+struct message_share : nadi_message_share {
+    nadi_message* origin;
+};
+
+// A single delivery: the header and the share of its payload in one allocation.
+struct single_share : message_share {
+    nadi_shared_message delivery;
+};
+
+inline void destroy_message_share(nadi_message_share* share) {
+    auto* owner = static_cast<message_share*>(share);
+    owner->origin->free(owner->origin);
+    delete owner;
+}
+
+inline void destroy_single_share(nadi_message_share* share) {
+    auto* owner = static_cast<single_share*>(share);
+    owner->origin->free(owner->origin);
+    delete owner;
+}
+
+inline void free_shared_message(nadi_message* message) {
+    auto* shared = reinterpret_cast<nadi_shared_message*>(message);
+    nadi_message_release(shared);
+    delete shared;
+}
+
+// The header lives in the share's block, so it is freed along with the last reference.
+inline void free_single_share(nadi_message* message) {
+    nadi_message_release(reinterpret_cast<nadi_shared_message*>(message));
+}
+
+} // namespace detail
+
+// Takes ownership of origin and returns a share of its payload holding references references,
+// each to be handed to one make_delivery. origin->free runs once all of them are released.
+inline nadi_message_share* share(nadi_message* origin, std::size_t references) {
+    auto* owner = new detail::message_share{};
+    owner->refcount = static_cast<std::int32_t>(references);
+    owner->destroy = detail::destroy_message_share;
+    owner->origin = origin;
+    return owner;
+}
+
+// Creates a header delivering the payload of share with the meta, data and sender of header,
+// adopting one of the references share() returned. The header's free callback releases that
+// reference and deletes it.
+inline nadi_shared_message* make_delivery(nadi_message_share* share, const nadi_message& header, unsigned int channel) {
+    auto* delivery = new nadi_shared_message{header, share};
+    delivery->message.channel = channel;
+    delivery->message.free = detail::free_shared_message;
+    return delivery;
+}
+
+// Takes ownership of message and returns it as a shared header, for receivers listing "shared
+// messages". Headers made in this module are returned as they are, any other message is wrapped
+// in a header holding the only reference to it, allocated together with its share.
+inline nadi_shared_message* make_shared(nadi_message* message) {
+    if (message->free == detail::free_shared_message || message->free == detail::free_single_share) {
+        return reinterpret_cast<nadi_shared_message*>(message);
+    }
+    auto* owner = new detail::single_share{};
+    owner->refcount = 1;
+    owner->destroy = detail::destroy_single_share;
+    owner->origin = message;
+    owner->delivery = {*message, owner};
+    owner->delivery.message.free = detail::free_single_share;
+    return &owner->delivery;
+}
+
+} // namespace nadi
@@ -0,0 +1,554 @@
+#include <nadi/context.hpp>
+
+#include "edge_queue.hpp"
+#include "epoch.hpp"
+#include "library.hpp"
+#include "routing_table.hpp"
+#include "trampolines.hpp"
+
+#include <nadi/message_pool.hpp>
+#include <nadi/message_validation.hpp>
+#include <nadi/meta_registry.hpp>
+#include <nadi/segmented_message.hpp>
+#include <nadi/shared_message.hpp>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <iterator>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace nadi {
+
+namespace {
+
+constexpr unsigned int command_channel = 0xF000;
+
+struct abstract_node {
+    std::string name;
+    std::unique_ptr<detail::library> lib;
+    detail::receive_callbacks callbacks;
+};
+
+} // namespace
+
+struct context::state final : detail::receive_target {
+    state(receive_function receive, std::size_t worker_count)
+        : host_{std::move(receive)},
+          table_{new detail::routing_table{{nullptr}, {}, 0}},
+          executor_{worker_count},
+          nodes_(1),
+          control_{[this] { run(); }} {}
+
+    ~state() {
+        {
+            std::lock_guard lock{queue_mutex_};
+            stopping_ = true;
+        }
+        queue_ready_.notify_one();
+        control_.join();
+
+        std::lock_guard lock{control_mutex_};
+        std::vector<detail::connection> connections = std::move(connections_);
+        connections_.clear();
+        std::vector<std::unique_ptr<detail::node_instance>> nodes = std::move(nodes_);
+        nodes_.resize(1);
+        publish();
+        retire(connections);
+        for (auto& node : nodes) {
+            if (!node) continue;
+            executor_.close(node->inbox);
+            node->lib->destroy(node->local);
+        }
+        for (auto& abstract : abstract_nodes_) detail::unbind(abstract.callbacks.binding);
+        delete table_.load();
+    }
+
+    // Must be called within a read section, the table stays valid until it is left.
+    const detail::routing_table& table() const noexcept { return *table_.load(std::memory_order_seq_cst); }
+
+    void receive(std::size_t abstract_node, nadi_message** messages, std::size_t count) override {
+        {
+            detail::epoch::guard guard;
+            const auto& current = table();
+            for (std::size_t i = 0; i < count; ++i) {
+                nadi_message* message = messages[i];
+                nadi_node_handle handle = current.handle(abstract_node, message->node);
+                if (handle == 0) {
+                    message->free(message);
+                    continue;
+                }
+                message->node = handle; // receivers see the sender's context handle
+                // a node answering NADI_WOULD_BLOCK signals free space by emitting, see mailbox
+                current.node(handle)->inbox.resume(executor_);
+                route(current, message);
+            }
+        }
+        resume_stalled();
+    }
+
+    void route(const detail::routing_table& current, nadi_message* message) {
+        auto destinations = current.destinations(message->node, message->channel);
+        if (destinations.empty()) {
+            message->free(message);
+        } else if (destinations.size() == 1) {
+            message->channel = destinations[0].channel;
+            deliver(current, destinations[0], message);
+        } else {
+            // fan-out shares the payload between one header per destination instead of copying it
+            nadi_message_share* shared = nadi::share(message, destinations.size());
+            for (const auto& destination : destinations) {
+                deliver(current, destination, &nadi::make_delivery(shared, *message, destination.channel)->message);
+            }
+        }
+    }
+
+    void deliver(const detail::routing_table& current, const detail::target& destination, nadi_message* message) {
+        if (destination.node == 0) {
+            receive_own(message);
+            return;
+        }
+        const detail::node_instance* target = current.node(destination.node);
+        if (!target) {
+            message->free(message);
+            return;
+        }
+        if (!(message = adapt(*target->lib, message))) return;
+        if (!destination.queue) {
+            target->inbox.post(message, executor_);
+        } else {
+            enqueue(*target, *destination.queue, message);
+        }
+    }
+
+    // Delivery refused by a full blocking connection. It waits until the producer has left its
+    // read section, so that publish() never waits for a blocked producer, and is then routed again.
+    struct stalled_delivery {
+        state* owner;
+        detail::edge_queue* queue; // acquired
+        nadi_message* message;
+    };
+
+    static inline thread_local std::deque<stalled_delivery> stalled_;
+    static inline thread_local bool resuming_ = false;
+
+    void enqueue(const detail::node_instance& target, detail::edge_queue& queue, nadi_message* message) {
+        using result = detail::edge_queue::push_result;
+        // behind a stalled message of the same connection, keeping them in order
+        bool behind = std::any_of(stalled_.begin(), stalled_.end(), [&](const stalled_delivery& s) { return s.queue == &queue; });
+        // the control thread cannot wait, as it would retire the queue; its responses overfill
+        switch (behind ? result::full : queue.push(message, std::this_thread::get_id() == control_.get_id())) {
+        case result::added:
+            target.inbox.post(queue, executor_);
+            break;
+        case result::dropped:
+            break;
+        case result::full:
+            queue.acquire();
+            stalled_.push_back({this, &queue, message});
+            break;
+        }
+    }
+
+    // Called after leaving a read section: waits for space for the deliveries stalled by full
+    // blocking connections, in order, and routes them again under the table published by then.
+    // Nested entry points leave this to the outermost one.
+    static void resume_stalled() {
+        if (stalled_.empty() || resuming_ || detail::epoch::reading()) return;
+        resuming_ = true;
+        while (!stalled_.empty()) {
+            stalled_delivery entry = stalled_.front(); // stays listed, see enqueue()
+            while (!entry.owner->resume(entry)) {}
+            stalled_.pop_front();
+            detail::edge_queue::release(entry.queue);
+        }
+        resuming_ = false;
+    }
+
+    // Returns false if the queue filled up again before the delivery got its space.
+    bool resume(const stalled_delivery& entry) {
+        if (!entry.queue->wait(executor_)) {
+            entry.message->free(entry.message); // disconnected meanwhile
+            return true;
+        }
+        detail::epoch::guard guard;
+        const auto& connections = table().connections();
+        auto it = std::find_if(connections.begin(), connections.end(), [&](const detail::connection& c) { return c.queue == entry.queue; });
+        const detail::node_instance* target = it != connections.end() ? table().node(it->destination.node) : nullptr;
+        if (!target) {
+            entry.message->free(entry.message);
+            return true;
+        }
+        if (entry.queue->push(entry.message) == detail::edge_queue::push_result::full) return false;
+        target->inbox.post(*entry.queue, executor_);
+        return true;
+    }
+
+    nadi_status send(nadi_message* message, nadi_node_handle node) {
+        if (!message) return NADI_INVALID_MESSAGE;
+        if (node == 0) {
+            {
+                detail::epoch::guard guard; // the host's receive function may route
+                receive_own(message);
+            }
+            resume_stalled();
+            return NADI_OK;
+        }
+        detail::epoch::guard guard;
+        const detail::node_instance* target = table().node(node);
+        if (!target) return NADI_INVALID_NODE;
+        bool copied = nadi::is_extended(*message) || (nadi::is_segmented(*message) && !target->lib->segmented);
+        if (copied && !target->lib->extended && nadi::payload_length(*message) >= NADI_EXTENDED) {
+            return NADI_INVALID_MESSAGE;
+        }
+        // past the check above this only fails when out of memory, with the message freed
+        if (!(message = adapt(*target->lib, message))) return NADI_OK;
+        target->inbox.post(message, executor_);
+        return NADI_OK;
+    }
+
+    // Takes ownership of message and returns it in a form lib accepts, nullptr if there is none.
+    static nadi_message* adapt(const detail::library& lib, nadi_message* message) {
+        if (!nadi::is_segmented(*message) || !lib.segmented) {
+            if (!(message = nadi::flatten(message, lib.extended))) return nullptr;
+        }
+        // flatten may have replaced a shared header, and single deliveries never had one
+        return lib.shared ? &nadi::make_shared(message)->message : message;
+    }
+
+    void receive_own(nadi_message* message) {
+        if (!(message = nadi::flatten(message, true))) return;
+        if (message->channel == command_channel) {
+            std::string command{nadi::payload_view(*message)};
+            message->free(message);
+            while (!command.empty() && command.back() == '\0') command.pop_back();
+            {
+                std::lock_guard lock{queue_mutex_};
+                commands_.push_back(std::move(command));
+            }
+            queue_ready_.notify_one();
+        } else if (host_) {
+            host_(message);
+        } else {
+            message->free(message);
+        }
+    }
+
+    void add_abstract_node(std::string_view name, const std::filesystem::path& path) {
+        std::lock_guard lock{control_mutex_};
+        if (find_abstract_node(name)) throw std::runtime_error{"abstract node " + std::string{name} + " already exists"};
+        auto lib = std::make_unique<detail::library>(path);
+        auto callbacks = detail::bind(*this, abstract_nodes_.size());
+        abstract_nodes_.push_back({std::string{name}, std::move(lib), callbacks});
+    }
+
+private:
+    // Control thread, everything below runs on it with control_mutex_ held where noted.
+
+    void run() {
+        std::unique_lock lock{queue_mutex_};
+        for (;;) {
+            queue_ready_.wait(lock, [this] { return stopping_ || !commands_.empty(); });
+            if (stopping_) return;
+            std::string command = std::move(commands_.front());
+            commands_.pop_front();
+            lock.unlock();
+            execute(command);
+            lock.lock();
+        }
+    }
+
+    void execute(const std::string& command) {
+        using validation::message_kind;
+        auto json = nlohmann::json::parse(command, nullptr, false);
+        switch (validation::validate_any(json)) {
+        case message_kind::context_node_create:
+            if (auto message = messages::decode<messages::context_node_create>(json)) create_node(*message);
+            break;
+        case message_kind::context_node_destroy:
+            if (auto message = messages::decode<messages::context_node_destroy>(json)) destroy_node(*message);
+            break;
+        case message_kind::context_connect:
+            if (auto message = messages::decode<messages::context_connect>(json)) connect(*message);
+            break;
+        case message_kind::context_disconnect:
+            if (auto message = messages::decode<messages::context_disconnect>(json)) disconnect(*message);
+            break;
+        case message_kind::context_connections:
+            if (auto message = messages::decode<messages::context_connections>(json)) list_connections(*message);
+            break;
+        case message_kind::context_abstract_nodes:
+            if (auto message = messages::decode<messages::context_abstract_nodes>(json)) list_abstract_nodes(*message);
+            break;
+        case message_kind::context_nodes:
+            if (auto message = messages::decode<messages::context_nodes>(json)) list_nodes(*message);
+            break;
+        default:
+            break; // malformed, or not a command of the context
+        }
+    }
+
+    void create_node(const messages::context_node_create& message) {
+        nadi_node_handle handle = 0; // 0 is never a created node and reports failure
+        {
+            std::lock_guard lock{control_mutex_};
+            std::size_t abstract = 0;
+            while (abstract < abstract_nodes_.size() && abstract_nodes_[abstract].name != message.abstract_name) ++abstract;
+            if (abstract < abstract_nodes_.size() && !find_node(message.instance_name)) {
+                const auto& source = abstract_nodes_[abstract];
+                nadi_node_handle local = 0;
+                nadi_status status = source.lib->create_ex
+                                         ? source.lib->create_ex(&local, source.callbacks.single, source.callbacks.batch)
+                                         : source.lib->create(&local, source.callbacks.single);
+                if (status == NADI_OK) {
+                    handle = nodes_.size();
+                    std::size_t affinity = message.affinity && *message.affinity >= 0 ? static_cast<std::size_t>(*message.affinity)
+                                                                                       : detail::mailbox::no_affinity;
+                    nodes_.push_back(std::make_unique<detail::node_instance>(std::string{message.instance_name}, abstract, *source.lib, local, affinity));
+                    publish();
+                }
+            }
+        }
+        respond({{"type", "context.node.create.confirm"},
+                 {"node", handle},
+                 {"instance_name", message.instance_name},
+                 {"id", message.id.value_or("")}});
+    }
+
+    void destroy_node(const messages::context_node_destroy& message) {
+        bool destroyed = false;
+        {
+            std::lock_guard lock{control_mutex_};
+            if (auto handle = find_node(message.instance_name)) {
+                auto touches = [&](const detail::connection& c) { return c.source.node == *handle || c.destination.node == *handle; };
+                std::vector<detail::connection> removed;
+                std::copy_if(connections_.begin(), connections_.end(), std::back_inserter(removed), touches);
+                std::erase_if(connections_, touches);
+                std::unique_ptr<detail::node_instance> node = std::move(nodes_[*handle]);
+                publish(); // after this nothing new is posted to the node's mailbox
+                retire(removed); // before nadi_destroy, which may join a thread waiting on one of them
+                executor_.close(node->inbox);
+                node->lib->destroy(node->local);
+                destroyed = true;
+            }
+        }
+        respond(with_id({{"type", "context.node.destroy.confirm"}, {"status", destroyed ? "success" : "error"}}, message.id));
+    }
+
+    void connect(const messages::context_connect& message) {
+        bool connected = false;
+        {
+            std::lock_guard lock{control_mutex_};
+            auto source = resolve(message.source);
+            auto destination = resolve(message.destination);
+            if (source && destination) {
+                detail::connection c{*source, *destination};
+                if (std::find(connections_.begin(), connections_.end(), c) == connections_.end()) {
+                    // the context itself receives synchronously, so connections to it need no queue
+                    if (message.queue && destination->node != 0) {
+                        // decoding checked capacity and policy against the schema
+                        c.queue = new detail::edge_queue{static_cast<std::size_t>(message.queue->capacity),
+                                                         *validation::queue_policy_of(message.queue->policy)};
+                    }
+                    connections_.push_back(c);
+                    publish();
+                }
+                connected = true;
+            }
+        }
+        respond(with_id({{"type", "context.connect.confirm"}, {"status", connected ? "success" : "error"}}, message.id));
+    }
+
+    void disconnect(const messages::context_disconnect& message) {
+        bool disconnected = false;
+        {
+            std::lock_guard lock{control_mutex_};
+            auto source = resolve(message.source);
+            auto destination = resolve(message.destination);
+            if (source && destination) {
+                auto it = std::find(connections_.begin(), connections_.end(), detail::connection{*source, *destination});
+                if (it != connections_.end()) {
+                    detail::connection removed = *it;
+                    connections_.erase(it);
+                    publish();
+                    retire({removed});
+                    disconnected = true;
+                }
+            }
+        }
+        respond(with_id({{"type", "context.disconnect.confirm"}, {"status", disconnected ? "success" : "error"}}, message.id));
+    }
+
+    void list_connections(const messages::context_connections& message) {
+        auto list = nlohmann::json::array();
+        {
+            std::lock_guard lock{control_mutex_};
+            for (const auto& c : connections_) {
+                nlohmann::json entry{{"source", {c.source.node, c.source.channel}}, {"target", {c.destination.node, c.destination.channel}}};
+                if (c.queue) {
+                    entry["queue"] = {{"capacity", c.queue->capacity()},
+                                      {"policy", policy_name(c.queue->policy())},
+                                      {"dropped", c.queue->dropped()}};
+                }
+                list.push_back(std::move(entry));
+            }
+        }
+        respond({{"type", "context.connections.list"}, {"connections", std::move(list)}, {"id", message.id}});
+    }
+
+    void list_abstract_nodes(const messages::context_abstract_nodes& message) {
+        auto list = nlohmann::json::array();
+        {
+            std::lock_guard lock{control_mutex_};
+            for (const auto& abstract : abstract_nodes_) {
+                auto descriptor = nlohmann::json::parse(abstract.lib->descriptor(), nullptr, false);
+                nlohmann::json entry{{"name", abstract.name}, {"version", ""}};
+                if (descriptor.is_object()) {
+                    if (auto it = descriptor.find("version"); it != descriptor.end() && it->is_string()) entry["version"] = *it;
+                    if (auto it = descriptor.find("description"); it != descriptor.end() && it->is_string()) entry["description"] = *it;
+                    if (auto it = descriptor.find("channels"); it != descriptor.end() && it->is_object()) entry["channels"] = *it;
+                }
+                list.push_back(std::move(entry));
+            }
+        }
+        respond({{"type", "context.abstract_nodes.list"}, {"instances", std::move(list)}, {"id", message.id}});
+    }
+
+    void list_nodes(const messages::context_nodes& message) {
+        auto list = nlohmann::json::array();
+        {
+            std::lock_guard lock{control_mutex_};
+            for (const auto& node : nodes_) {
+                if (node) list.push_back({{"instance", node->name}});
+            }
+        }
+        respond({{"type", "context.nodes.list"}, {"instances", std::move(list)}, {"id", message.id}});
+    }
+
+    static const char* policy_name(validation::queue_policy policy) {
+        switch (policy) {
+        case validation::queue_policy::block: return "block";
+        case validation::queue_policy::drop_oldest: return "drop_oldest";
+        case validation::queue_policy::drop_newest: return "drop_newest";
+        case validation::queue_policy::latest: return "latest";
+        }
+        return "";
+    }
+
+    static nlohmann::json with_id(nlohmann::json response, std::optional<std::string_view> id) {
+        if (id) response["id"] = *id;
+        return response;
+    }
+
+    // Sends response from the 0xF000 output of the context.
+    void respond(const nlohmann::json& response) {
+        std::string text = response.dump();
+        nadi_message* message = message_pool::instance().allocate(json_meta_, text.size() + 1);
+        std::memcpy(message->data, text.c_str(), text.size() + 1);
+        message->channel = command_channel;
+        message->node = 0;
+        {
+            detail::epoch::guard guard;
+            route(table(), message);
+        }
+        resume_stalled();
+    }
+
+    // Requires control_mutex_.
+    const abstract_node* find_abstract_node(std::string_view name) const {
+        for (const auto& abstract : abstract_nodes_) {
+            if (abstract.name == name) return &abstract;
+        }
+        return nullptr;
+    }
+
+    // Requires control_mutex_.
+    std::optional<nadi_node_handle> find_node(std::string_view name) const {
+        for (nadi_node_handle handle = 1; handle < nodes_.size(); ++handle) {
+            if (nodes_[handle] && nodes_[handle]->name == name) return handle;
+        }
+        return std::nullopt;
+    }
+
+    // Requires control_mutex_. Nodes are given by name or handle, 0 being the context.
+    std::optional<detail::endpoint> resolve(const std::pair<messages::string_or_integer, std::int64_t>& endpoint) const {
+        if (endpoint.second < 0 || endpoint.second > 0xFFFF) return std::nullopt;
+        auto channel = static_cast<unsigned int>(endpoint.second);
+        if (auto* name = std::get_if<std::string_view>(&endpoint.first)) {
+            auto handle = find_node(*name);
+            if (!handle) return std::nullopt;
+            return detail::endpoint{*handle, channel};
+        }
+        auto handle = std::get<std::int64_t>(endpoint.first);
+        if (handle < 0 || static_cast<std::uint64_t>(handle) >= nodes_.size()) return std::nullopt;
+        if (handle != 0 && !nodes_[handle]) return std::nullopt;
+        return detail::endpoint{static_cast<nadi_node_handle>(handle), channel};
+    }
+
+    // Requires control_mutex_. The connections must be unreachable from the published table.
+    static void retire(const std::vector<detail::connection>& removed) {
+        for (const auto& c : removed) {
+            if (c.queue) detail::edge_queue::retire(c.queue);
+        }
+    }
+
+    // Requires control_mutex_. Builds and publishes the table of the current nodes and
+    // connections, then waits until no reader can see the previous one and deletes it.
+    void publish() {
+        std::vector<const detail::node_instance*> nodes;
+        nodes.reserve(nodes_.size());
+        for (const auto& node : nodes_) nodes.push_back(node.get());
+        auto* next = new detail::routing_table{std::move(nodes), connections_, abstract_nodes_.size()};
+        const detail::routing_table* previous = table_.exchange(next, std::memory_order_seq_cst);
+        detail::epoch::instance().synchronize();
+        delete previous;
+    }
+
+    receive_function host_;
+    interned_meta json_meta_ = meta_registry::instance().intern("json");
+    std::atomic<const detail::routing_table*> table_;
+
+    detail::executor executor_;
+
+    std::mutex control_mutex_;
+    std::vector<abstract_node> abstract_nodes_;
+    std::vector<std::unique_ptr<detail::node_instance>> nodes_; // indexed by handle, [0] is the context itself
+    std::vector<detail::connection> connections_;
+
+    std::mutex queue_mutex_;
+    std::condition_variable queue_ready_;
+    std::deque<std::string> commands_;
+    bool stopping_ = false;
+    std::thread control_;
+};
+
+context::context(receive_function receive, std::size_t worker_count)
+    : state_{std::make_unique<state>(std::move(receive), worker_count)} {}
+
+context::~context() = default;
+
+void context::add_abstract_node(std::string_view name, const std::filesystem::path& path) {
+    state_->add_abstract_node(name, path);
+}
+
+nadi_status context::send(nadi_message* message, nadi_node_handle node) {
+    return state_->send(message, node);
+}
+
+void context::route(nadi_message* message) {
+    {
+        detail::epoch::guard guard;
+        state_->route(state_->table(), message);
+    }
+    state::resume_stalled();
+}
+
+} // namespace nadi
@@ -0,0 +1,88 @@
+#include "edge_queue.hpp"
+
+#include "executor.hpp"
+
+#include <chrono>
+
+namespace nadi::detail {
+
+edge_queue::push_result edge_queue::push(nadi_message* message, bool overfill) {
+    std::unique_lock lock{mutex_};
+    nadi_message* victim = nullptr;
+    if (messages_.size() < capacity_ || (overfill && policy_ == validation::queue_policy::block)) {
+        messages_.push_back(message);
+        return push_result::added;
+    }
+    switch (policy_) {
+    case validation::queue_policy::block:
+        return push_result::full;
+    case validation::queue_policy::drop_oldest:
+        victim = messages_.front();
+        messages_.pop_front();
+        messages_.push_back(message); // the mail posted for the dropped message now takes this one
+        break;
+    case validation::queue_policy::drop_newest:
+        victim = message;
+        break;
+    case validation::queue_policy::latest:
+        victim = messages_.back();
+        messages_.back() = message;
+        break;
+    }
+    lock.unlock();
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    victim->free(victim);
+    return push_result::dropped;
+}
+
+nadi_message* edge_queue::take(edge_queue* queue) noexcept {
+    std::unique_lock lock{queue->mutex_};
+    nadi_message* message = queue->messages_.front();
+    queue->messages_.pop_front();
+    if (queue->holders_ > 0) queue->space_.notify_all();
+    bool last = queue->retired_ && queue->messages_.empty() && queue->holders_ == 0;
+    lock.unlock();
+    if (last) delete queue;
+    return message;
+}
+
+void edge_queue::acquire() noexcept {
+    std::lock_guard lock{mutex_};
+    ++holders_;
+}
+
+void edge_queue::release(edge_queue* queue) noexcept {
+    std::unique_lock lock{queue->mutex_};
+    bool last = --queue->holders_ == 0 && queue->retired_ && queue->messages_.empty();
+    lock.unlock();
+    if (last) delete queue;
+}
+
+bool edge_queue::wait(executor& runner) {
+    std::unique_lock lock{mutex_};
+    while (!retired_ && messages_.size() >= capacity_) {
+        // A worker waiting here may hold the only worker thread, so it first runs the mailboxes
+        // it can reach, the destination's among them if it is ready.
+        lock.unlock();
+        bool ran = runner.run_one();
+        lock.lock();
+        if (ran || retired_ || messages_.size() < capacity_) continue;
+        if (runner.on_worker()) {
+            space_.wait_for(lock, std::chrono::milliseconds{1});
+        } else {
+            space_.wait(lock);
+        }
+    }
+    return !retired_;
+}
+
+void edge_queue::retire(edge_queue* queue) noexcept {
+    std::unique_lock lock{queue->mutex_};
+    queue->retired_ = true;
+    queue->space_.notify_all();
+    bool empty = queue->messages_.empty() && queue->holders_ == 0;
+    lock.unlock();
+    if (empty) delete queue;
+}
+
+} // namespace nadi::detail
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <nadi/message_validation.hpp>
+#include <nadi/nadi.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+namespace nadi::detail {
+
+class executor;
+
+// Bounded queue of one connection created with a "queue" in context.connect. Messages wait here
+// instead of in the destination's mailbox, which gets one mail per queued message telling it to
+// take the oldest one. Dropping and replacing thus never touch the lock-free mailbox, and the
+// messages of the connection stay in order. Unbounded connections do not pay for the lock.
+class edge_queue {
+public:
+    edge_queue(std::size_t capacity, validation::queue_policy policy) noexcept : capacity_{capacity}, policy_{policy} {}
+
+    edge_queue(const edge_queue&) = delete;
+    edge_queue& operator=(const edge_queue&) = delete;
+
+    enum class push_result {
+        added,   // the caller posts a mail for it to the destination
+        dropped, // the policy dropped or replaced a message, no mail is needed
+        full,    // queue_policy::block only, the caller keeps the message
+    };
+
+    // Takes ownership of message unless the result is push_result::full, applying the policy if
+    // the queue is full. A blocking queue refuses the message then, unless overfill is set. Never
+    // waits, as a producer must not wait within a read section; see wait().
+    push_result push(nadi_message* message, bool overfill = false);
+
+    // Removes the oldest message, once per mail posted for the queue. Deletes a retired queue
+    // along with its last message.
+    static nadi_message* take(edge_queue* queue) noexcept;
+
+    // Keeps a queue reached within a read section alive after it is left, until release().
+    void acquire() noexcept;
+    static void release(edge_queue* queue) noexcept;
+
+    // Waits until the queue has space or is retired, returning false once retired. Must be called
+    // outside of read sections on an acquired queue. A worker of runner keeps running other
+    // mailboxes meanwhile.
+    bool wait(executor& runner);
+
+    // Called once the connection is unreachable from published routing tables. Wakes the waiting
+    // producers; the queue is deleted now if empty and not acquired, otherwise by the last take()
+    // or release().
+    static void retire(edge_queue* queue) noexcept;
+
+    std::size_t capacity() const noexcept { return capacity_; }
+    validation::queue_policy policy() const noexcept { return policy_; }
+    std::uint64_t dropped() const noexcept { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    const std::size_t capacity_;
+    const validation::queue_policy policy_;
+    std::atomic<std::uint64_t> dropped_{0};
+    std::mutex mutex_;
+    std::condition_variable space_;
+    std::deque<nadi_message*> messages_;
+    std::size_t holders_ = 0; // acquired, see acquire()
+    bool retired_ = false;
+};
+
+} // namespace nadi::detail
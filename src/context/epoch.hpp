@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+namespace nadi::detail {
+
+// Epoch based reclamation protecting the published routing tables. Readers announce the epoch
+// they entered in their own slot and never wait; a writer swaps in a new table and then waits in
+// synchronize() until no reader can still hold the old one, after which it may be deleted.
+// Read sections nest, as a delivery can synchronously trigger another one on the same thread.
+class epoch {
+public:
+    static epoch& instance() {
+        static epoch* domain = new epoch{};
+        return *domain;
+    }
+
+    class guard {
+    public:
+        guard() noexcept { instance().enter(); }
+        ~guard() { instance().leave(); }
+        guard(const guard&) = delete;
+        guard& operator=(const guard&) = delete;
+    };
+
+    // Whether the calling thread is within a read section.
+    static bool reading() noexcept { return state().depth > 0; }
+
+    // Waits until every read section entered before the call has been left. Must not be called
+    // from within a read section.
+    void synchronize() noexcept {
+        std::uint64_t target = current_.fetch_add(1, std::memory_order_seq_cst) + 1;
+        for (auto& slot : slots_) {
+            for (;;) {
+                std::uint64_t entered = slot.epoch.load(std::memory_order_seq_cst);
+                if (entered == 0 || entered >= target) break;
+                std::this_thread::yield();
+            }
+        }
+        while (overflow_.load(std::memory_order_seq_cst) != 0) std::this_thread::yield();
+    }
+
+private:
+    static constexpr std::size_t max_threads = 256;
+    static constexpr int no_slot = -1;
+    static constexpr int overflow = -2; // all slots taken, the thread is counted in overflow_ instead
+
+    struct alignas(64) slot {
+        std::atomic<std::uint64_t> epoch{0}; // 0 outside of read sections
+        std::atomic<bool> claimed{false};
+    };
+
+    struct thread_state {
+        int slot = no_slot;
+        int depth = 0;
+
+        ~thread_state() {
+            if (slot >= 0) instance().slots_[slot].claimed.store(false, std::memory_order_release);
+        }
+    };
+
+    epoch() = default;
+
+    static thread_state& state() noexcept {
+        thread_local thread_state state;
+        return state;
+    }
+
+    int claim() noexcept {
+        for (std::size_t i = 0; i < max_threads; ++i) {
+            bool expected = false;
+            if (slots_[i].claimed.compare_exchange_strong(expected, true, std::memory_order_acquire)) return static_cast<int>(i);
+        }
+        return overflow;
+    }
+
+    void enter() noexcept {
+        auto& local = state();
+        if (local.depth++ != 0) return;
+        if (local.slot == no_slot) local.slot = claim();
+        if (local.slot == overflow) {
+            overflow_.fetch_add(1, std::memory_order_seq_cst);
+        } else {
+            slots_[local.slot].epoch.store(current_.load(std::memory_order_relaxed), std::memory_order_seq_cst);
+        }
+    }
+
+    void leave() noexcept {
+        auto& local = state();
+        if (--local.depth != 0) return;
+        if (local.slot == overflow) {
+            overflow_.fetch_sub(1, std::memory_order_release);
+        } else {
+            slots_[local.slot].epoch.store(0, std::memory_order_release);
+        }
+    }
+
+    std::atomic<std::uint64_t> current_{1};
+    std::atomic<std::size_t> overflow_{0}; // writers may wait for these readers indefinitely under constant load
+    slot slots_[max_threads];
+};
+
+} // namespace nadi::detail
@@ -0,0 +1,218 @@
+#include "executor.hpp"
+
+#include "edge_queue.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+namespace nadi::detail {
+
+bool mailbox::send(nadi_message** messages, std::size_t count) noexcept {
+    if (count > 1 && lib_.send_batch) {
+        nadi_status statuses[max_batch];
+        std::size_t accepted = 0;
+        lib_.send_batch(messages, count, local_, statuses, &accepted);
+        accepted = std::min(accepted, count);
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < accepted; ++i) {
+            if (statuses[i] == NADI_WOULD_BLOCK) {
+                messages[kept++] = messages[i];
+            } else if (statuses[i] != NADI_OK) {
+                messages[i]->free(messages[i]);
+            }
+        }
+        if (kept > 0) {
+            // the node is full, keep what it refused and did not look at, in order
+            std::copy(messages + accepted, messages + count, messages + kept);
+            return defer(messages, kept + count - accepted);
+        }
+        // the node stopped early, offer the rest one by one
+        messages += accepted;
+        count -= accepted;
+    }
+    for (std::size_t i = 0; i < count; ++i) {
+        nadi_status status = lib_.send(messages[i], local_);
+        if (status == NADI_WOULD_BLOCK) return defer(messages + i, count - i);
+        if (status != NADI_OK) messages[i]->free(messages[i]);
+    }
+    return true;
+}
+
+bool mailbox::defer(nadi_message** messages, std::size_t count) noexcept {
+    if (closing_.load(std::memory_order_seq_cst)) {
+        // the node is being destroyed and will not make room any more
+        for (std::size_t i = 0; i < count; ++i) messages[i]->free(messages[i]);
+        return true;
+    }
+    std::copy_n(messages, count, deferred_);
+    deferred_count_ = count;
+    return false;
+}
+
+namespace {
+
+// Worker running on the current thread, so mailboxes made ready by a node's callback stay on
+// that worker's deque.
+struct worker_identity {
+    const executor* owner = nullptr;
+    std::size_t index = 0;
+};
+
+thread_local worker_identity current_worker;
+
+} // namespace
+
+executor::executor(std::size_t worker_count) {
+    if (worker_count == 0) worker_count = std::max(1u, std::thread::hardware_concurrency());
+    workers_.reserve(worker_count);
+    for (std::size_t i = 0; i < worker_count; ++i) workers_.push_back(std::make_unique<worker>());
+    for (std::size_t i = 0; i < worker_count; ++i) workers_[i]->thread = std::thread{[this, i] { run(i); }};
+}
+
+executor::~executor() {
+    stopping_.store(true, std::memory_order_seq_cst);
+    for (auto& w : workers_) wake(*w);
+    for (auto& w : workers_) w->thread.join();
+}
+
+void executor::schedule(mailbox& box) {
+    std::size_t count = workers_.size();
+    bool pinned = box.affinity_ != no_affinity;
+    std::size_t target = pinned ? box.affinity_ % count : 0;
+    if (current_worker.owner == this && (!pinned || target == current_worker.index)) {
+        workers_[current_worker.index]->ready.push(&box);
+        wake_any();
+        return;
+    }
+    if (!pinned) target = (reinterpret_cast<std::uintptr_t>(&box) / alignof(mailbox)) % count;
+    worker& w = *workers_[target];
+    w.inbox.push(&box);
+    wake(w);
+}
+
+void executor::close(mailbox& box) {
+    box.closing_.store(true, std::memory_order_seq_cst);
+    if (!box.scheduled_.exchange(true, std::memory_order_seq_cst)) schedule(box);
+    std::unique_lock lock{close_mutex_};
+    closed_.wait(lock, [&] { return box.closed_.load(std::memory_order_acquire); });
+}
+
+bool executor::on_worker() const noexcept {
+    return current_worker.owner == this;
+}
+
+bool executor::run_one() noexcept {
+    if (!on_worker()) return false;
+    std::size_t index = current_worker.index;
+    mailbox* box = find_work(index);
+    if (!box) return false;
+    drain(*box, index);
+    return true;
+}
+
+void executor::wake(worker& w) noexcept {
+    if (w.sleeping.load(std::memory_order_seq_cst) && w.sleeping.exchange(false, std::memory_order_seq_cst)) {
+        w.sleeping.notify_one();
+    }
+}
+
+void executor::wake_any() noexcept {
+    if (sleepers_.load(std::memory_order_seq_cst) == 0) return;
+    for (auto& w : workers_) {
+        if (w->sleeping.load(std::memory_order_seq_cst) && w->sleeping.exchange(false, std::memory_order_seq_cst)) {
+            w->sleeping.notify_one();
+            return;
+        }
+    }
+}
+
+mailbox* executor::find_work(std::size_t index) noexcept {
+    worker& self = *workers_[index];
+    if (mailbox* box = self.ready.pop()) return box;
+    // Mailboxes in the inbox move to the deque, where idle workers can steal them, so affinity
+    // is a preference rather than a pin.
+    while (mpsc_link* link = self.inbox.pop()) self.ready.push(static_cast<mailbox*>(link));
+    if (mailbox* box = self.ready.pop()) return box;
+    for (std::size_t i = 1; i < workers_.size(); ++i) {
+        if (mailbox* box = workers_[(index + i) % workers_.size()]->ready.steal()) return box;
+    }
+    return nullptr;
+}
+
+bool executor::has_work(std::size_t index) const noexcept {
+    const worker& self = *workers_[index];
+    if (!self.ready.empty() || !self.inbox.empty()) return true;
+    for (const auto& w : workers_) {
+        if (!w->ready.empty()) return true;
+    }
+    return false;
+}
+
+void executor::run(std::size_t index) noexcept {
+    current_worker = {this, index};
+    worker& self = *workers_[index];
+    for (;;) {
+        if (mailbox* box = find_work(index)) {
+            drain(*box, index);
+            continue;
+        }
+        if (stopping_.load(std::memory_order_seq_cst)) return;
+        self.sleeping.store(true, std::memory_order_seq_cst);
+        sleepers_.fetch_add(1, std::memory_order_seq_cst);
+        if (has_work(index) || stopping_.load(std::memory_order_seq_cst)) {
+            self.sleeping.store(false, std::memory_order_seq_cst);
+        } else {
+            self.sleeping.wait(true, std::memory_order_seq_cst);
+        }
+        sleepers_.fetch_sub(1, std::memory_order_seq_cst);
+    }
+}
+
+void executor::drain(mailbox& box, std::size_t index) noexcept {
+    // messages refused with NADI_WOULD_BLOCK go first, then new mail
+    nadi_message* messages[mailbox::max_batch];
+    std::size_t count = std::exchange(box.deferred_count_, 0);
+    std::copy_n(box.deferred_, count, messages);
+    std::size_t popped = 0;
+    while (count < mailbox::max_batch) {
+        mpsc_link* link = box.queue_.pop();
+        if (!link) break;
+        auto* m = static_cast<mail*>(link);
+        messages[count++] = m->queue ? edge_queue::take(m->queue) : m->message;
+        object_pool<mail>::release(m);
+        ++popped;
+    }
+    if (popped > 0) box.pending_.fetch_sub(static_cast<std::int64_t>(popped), std::memory_order_seq_cst);
+    bool blocked = false;
+    if (count > 0) {
+        box.blocked_.store(false, std::memory_order_seq_cst);
+        if (box.resumed_.load(std::memory_order_relaxed)) box.resumed_.store(false, std::memory_order_seq_cst);
+        blocked = !box.send(messages, count);
+    }
+
+    if (box.closing_.load(std::memory_order_seq_cst) && box.pending_.load(std::memory_order_seq_cst) == 0 &&
+        box.deferred_count_ == 0) {
+        // box may be destroyed as soon as closed_ is seen, so it is not touched afterwards
+        {
+            std::lock_guard lock{close_mutex_};
+            box.closed_.store(true, std::memory_order_release);
+        }
+        closed_.notify_all();
+        return;
+    }
+
+    // Give up the mailbox, then take it back if mail arrived in between and no producer did. It
+    // goes to the back of this worker's inbox, so the other ready mailboxes get their turn first.
+    // A blocked mailbox is parked instead, unless the node emitted something since the attempt:
+    // either this check sees resumed_, or resume() sees blocked_ and schedules it.
+    if (blocked) box.blocked_.store(true, std::memory_order_seq_cst);
+    box.scheduled_.store(false, std::memory_order_seq_cst);
+    bool again = blocked ? box.resumed_.load(std::memory_order_seq_cst) || !box.blocked_.load(std::memory_order_seq_cst)
+                         : box.pending_.load(std::memory_order_seq_cst) > 0;
+    if (again || box.closing_.load(std::memory_order_seq_cst)) {
+        if (!box.scheduled_.exchange(true, std::memory_order_seq_cst)) workers_[index]->inbox.push(&box);
+    }
+}
+
+} // namespace nadi::detail
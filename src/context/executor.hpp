@@ -0,0 +1,147 @@
+#pragma once
+
+#include "library.hpp"
+#include "mpsc_queue.hpp"
+#include "object_pool.hpp"
+#include "work_deque.hpp"
+#include <nadi/nadi.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace nadi::detail {
+
+class edge_queue;
+class executor;
+
+struct mail : mpsc_link {
+    explicit mail(nadi_message* message) noexcept : message{message} {}
+    explicit mail(edge_queue& queue) noexcept : queue{&queue} {}
+    nadi_message* message = nullptr;
+    edge_queue* queue = nullptr; // set instead of message: take the oldest message of the connection's queue
+};
+
+// Messages waiting to be sent to one node. Any thread may post; only the worker currently
+// holding the mailbox (scheduled_ set) pops and calls nadi_send, so a slow node delays neither
+// its producers nor other nodes, and the messages of each edge stay in order. The mpsc_link
+// base queues the mailbox in a worker's inbox.
+//
+// A node answering NADI_WOULD_BLOCK keeps the refused messages in deferred_ and parks the
+// mailbox (blocked_ set, not scheduled): it holds no worker until the node emits any message,
+// which calls resume(), and the deferred messages are retried before newer mail.
+class mailbox : public mpsc_link {
+public:
+    static constexpr std::size_t no_affinity = SIZE_MAX;
+
+    mailbox(library& lib, nadi_node_handle local, std::size_t affinity = no_affinity) noexcept : lib_{lib}, local_{local}, affinity_{affinity} {}
+
+    // Takes ownership of message, which is sent to the node later on a worker.
+    void post(nadi_message* message, executor& runner) { post(object_pool<mail>::make(message), runner); }
+
+    // Tells the node to take one message from queue, after edge_queue::push added one.
+    void post(edge_queue& queue, executor& runner) { post(object_pool<mail>::make(queue), runner); }
+
+    // Called for every message the node emits, reschedules the mailbox if it is parked.
+    void resume(executor& runner);
+
+private:
+    friend class executor;
+
+    static constexpr std::size_t max_batch = 64; // messages sent per turn, so busy nodes cannot starve others
+
+    void post(mail* item, executor& runner);
+
+    // false if the node would block, the unsent messages are then in deferred_
+    bool send(nadi_message** messages, std::size_t count) noexcept;
+    bool defer(nadi_message** messages, std::size_t count) noexcept;
+
+    library& lib_;
+    nadi_node_handle local_;
+    std::size_t affinity_; // preferred worker modulo the worker count, or no_affinity
+    mpsc_queue queue_;
+    std::atomic<std::int64_t> pending_{0}; // counted before the push, so it is never behind the queue
+    std::atomic<bool> scheduled_{false};
+    std::atomic<bool> closing_{false};
+    std::atomic<bool> closed_{false};
+    std::atomic<bool> blocked_{false};
+    std::atomic<bool> resumed_{false}; // the node emitted something since the last send attempt
+    nadi_message* deferred_[max_batch];
+    std::size_t deferred_count_ = 0;
+};
+
+// Pool of workers draining the mailboxes that have mail. Each worker owns a Chase-Lev deque of
+// ready mailboxes and an inbox for mailboxes made ready by other threads. A mailbox made ready
+// on a worker stays on that worker, next to the data its producer just touched, unless the node
+// has an affinity hint, in which case it goes to the inbox of that worker. Idle workers steal
+// from the other deques, so throughput scales with the number of workers while each mailbox is
+// still drained by one worker at a time, keeping the order of every edge.
+class executor {
+public:
+    // 0 workers means one per hardware thread.
+    explicit executor(std::size_t worker_count = 0);
+    ~executor(); // all mailboxes must be closed
+
+    executor(const executor&) = delete;
+    executor& operator=(const executor&) = delete;
+
+    std::size_t worker_count() const noexcept { return workers_.size(); }
+
+    // Called by whoever set box.scheduled_.
+    void schedule(mailbox& box);
+
+    // Sends the remaining mail of box and waits until no worker touches it any more. No more
+    // mail may be posted, i.e. box is unreachable from published routing tables.
+    void close(mailbox& box);
+
+    bool on_worker() const noexcept;
+
+    // Drains one ready mailbox if called on a worker, for threads that wait for other mailboxes
+    // to make progress. Returns false if there was none or this is not a worker.
+    bool run_one() noexcept;
+
+private:
+    static constexpr std::size_t no_affinity = mailbox::no_affinity;
+
+    struct worker {
+        work_deque<mailbox> ready;
+        mpsc_queue inbox;
+        std::atomic<bool> sleeping{false};
+        std::thread thread;
+    };
+
+    void run(std::size_t index) noexcept;
+    mailbox* find_work(std::size_t index) noexcept;
+    bool has_work(std::size_t index) const noexcept;
+    void drain(mailbox& box, std::size_t index) noexcept;
+    void wake(worker& w) noexcept;
+    void wake_any() noexcept;
+
+    std::vector<std::unique_ptr<worker>> workers_;
+    std::atomic<std::size_t> sleepers_{0};
+    std::atomic<bool> stopping_{false};
+    std::mutex close_mutex_;
+    std::condition_variable closed_;
+};
+
+inline void mailbox::post(mail* item, executor& runner) {
+    pending_.fetch_add(1, std::memory_order_seq_cst);
+    queue_.push(item);
+    if (blocked_.load(std::memory_order_seq_cst)) return; // resume() schedules it
+    if (!scheduled_.exchange(true, std::memory_order_seq_cst)) runner.schedule(*this);
+}
+
+inline void mailbox::resume(executor& runner) {
+    // the load keeps the common case free of writes to the mailbox
+    if (!resumed_.load(std::memory_order_seq_cst)) resumed_.store(true, std::memory_order_seq_cst);
+    if (blocked_.load(std::memory_order_seq_cst) && blocked_.exchange(false, std::memory_order_seq_cst) &&
+        !scheduled_.exchange(true, std::memory_order_seq_cst)) {
+        runner.schedule(*this);
+    }
+}
+
+} // namespace nadi::detail
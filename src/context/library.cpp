@@ -0,0 +1,91 @@
+#include "library.hpp"
+
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+namespace nadi::detail {
+
+library::library(const std::filesystem::path& path) {
+#ifdef _WIN32
+    handle_ = LoadLibraryW(path.c_str());
+#else
+    handle_ = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+#endif
+    if (!handle_) throw std::runtime_error{"cannot load NADI library " + path.string()};
+
+    create = reinterpret_cast<decltype(create)>(symbol("nadi_create"));
+    destroy = reinterpret_cast<decltype(destroy)>(symbol("nadi_destroy"));
+    send = reinterpret_cast<decltype(send)>(symbol("nadi_send"));
+    auto descriptor = reinterpret_cast<decltype(&nadi_descriptor)>(symbol("nadi_descriptor"));
+    auto descriptor_view = reinterpret_cast<decltype(&nadi_descriptor_view)>(symbol("nadi_descriptor_view"));
+    if (!create || !destroy || !send || !descriptor) {
+        close();
+        throw std::runtime_error{"not a NADI library: " + path.string()};
+    }
+
+    const char* view = nullptr;
+    std::size_t length = 0;
+    if (descriptor_view && descriptor_view(&view, &length) == NADI_OK && view) {
+        descriptor_.assign(view, length > 0 ? length - 1 : 0);
+    } else {
+        std::string buffer(1024, '\0');
+        length = buffer.size();
+        nadi_status status = descriptor(buffer.data(), &length);
+        if (status == NADI_BUFFER_TOO_SMALL) {
+            buffer.resize(length);
+            status = descriptor(buffer.data(), &length);
+        }
+        if (status == NADI_OK) descriptor_.assign(buffer.data(), length > 0 ? length - 1 : 0);
+    }
+
+    auto json = nlohmann::json::parse(descriptor_, nullptr, false);
+    if (json.is_object()) {
+        auto it = json.find("features");
+        if (it != json.end() && it->is_array()) {
+            for (const auto& feature : *it) {
+                if (feature.is_string()) features_.push_back(feature.get<std::string>());
+            }
+        }
+    }
+
+    if (has_feature("receive batch")) create_ex = reinterpret_cast<decltype(create_ex)>(symbol("nadi_create_ex"));
+    if (has_feature("send batch")) send_batch = reinterpret_cast<decltype(send_batch)>(symbol("nadi_send_batch"));
+    extended = has_feature("extended messages");
+    segmented = has_feature("segmented messages");
+    shared = has_feature("shared messages");
+}
+
+library::~library() {
+    close();
+}
+
+void library::close() noexcept {
+    if (!handle_) return;
+#ifdef _WIN32
+    FreeLibrary(static_cast<HMODULE>(handle_));
+#else
+    dlclose(handle_);
+#endif
+    handle_ = nullptr;
+}
+
+bool library::has_feature(std::string_view name) const {
+    return std::find(features_.begin(), features_.end(), name) != features_.end();
+}
+
+void* library::symbol(const char* name) const {
+#ifdef _WIN32
+    return reinterpret_cast<void*>(GetProcAddress(static_cast<HMODULE>(handle_), name));
+#else
+    return dlsym(handle_, name);
+#endif
+}
+
+} // namespace nadi::detail
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <nadi/nadi.h>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace nadi::detail {
+
+// NADI library loaded at runtime with its entry points resolved. Optional entry points are
+// nullptr unless the library exports them and lists the matching feature in its descriptor.
+class library {
+public:
+    // Throws std::runtime_error if the library cannot be loaded or lacks a required entry point.
+    explicit library(const std::filesystem::path& path);
+    ~library();
+
+    library(const library&) = delete;
+    library& operator=(const library&) = delete;
+
+    bool has_feature(std::string_view name) const;
+
+    const std::string& descriptor() const { return descriptor_; }
+
+    decltype(&nadi_create) create = nullptr;
+    decltype(&nadi_create_ex) create_ex = nullptr;
+    decltype(&nadi_destroy) destroy = nullptr;
+    decltype(&nadi_send) send = nullptr;
+    decltype(&nadi_send_batch) send_batch = nullptr;
+    bool segmented = false; // accepts segmented messages, see nadi_segments
+    bool shared = false;    // gets every message as a nadi_shared_message
+    bool extended = false;  // accepts extended messages
+
+private:
+    void* symbol(const char* name) const;
+    void close() noexcept;
+
+    void* handle_ = nullptr;
+    std::string descriptor_;
+    std::vector<std::string> features_;
+};
+
+} // namespace nadi::detail
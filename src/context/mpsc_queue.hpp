@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+
+namespace nadi::detail {
+
+struct mpsc_link {
+    std::atomic<mpsc_link*> next{nullptr};
+};
+
+// Intrusive multi-producer single-consumer queue (Vyukov). push is one exchange and never waits;
+// pop may return nullptr while a push is half done, the element then shows up on a later call.
+class mpsc_queue {
+public:
+    mpsc_queue() = default;
+    mpsc_queue(const mpsc_queue&) = delete;
+    mpsc_queue& operator=(const mpsc_queue&) = delete;
+
+    void push(mpsc_link* link) noexcept {
+        link->next.store(nullptr, std::memory_order_relaxed);
+        mpsc_link* previous = head_.exchange(link, std::memory_order_seq_cst);
+        previous->next.store(link, std::memory_order_release);
+    }
+
+    // Consumer only.
+    mpsc_link* pop() noexcept {
+        mpsc_link* tail = tail_;
+        mpsc_link* next = tail->next.load(std::memory_order_acquire);
+        if (tail == &stub_) {
+            if (!next) return nullptr;
+            tail_ = tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (next) {
+            tail_ = next;
+            return tail;
+        }
+        if (tail != head_.load(std::memory_order_acquire)) return nullptr;
+        push(&stub_);
+        next = tail->next.load(std::memory_order_acquire);
+        if (!next) return nullptr;
+        tail_ = next;
+        return tail;
+    }
+
+    // Consumer only. False also while a push is in progress.
+    bool empty() const noexcept { return tail_ == &stub_ && head_.load(std::memory_order_seq_cst) == &stub_; }
+
+private:
+    mpsc_link stub_;
+    std::atomic<mpsc_link*> head_{&stub_};
+    mpsc_link* tail_ = &stub_;
+};
+
+} // namespace nadi::detail
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <type_traits>
+
+namespace nadi::detail {
+
+// Free list for small internal objects allocated on one thread and released on another, the
+// same scheme as nadi::message_pool: per-thread caches exchanging batches through a shared list.
+// There is one never-destroyed pool per T.
+template <class T>
+class object_pool {
+    static_assert(std::is_trivially_destructible_v<T>);
+
+public:
+    template <class... Args>
+    static T* make(Args&&... args) {
+        auto& local = cache();
+        if (!local.head) instance().refill(local);
+        node* n = local.head;
+        local.head = n->next;
+        --local.count;
+        return new (n) T{std::forward<Args>(args)...};
+    }
+
+    static void release(T* object) noexcept {
+        auto& local = cache();
+        auto* n = reinterpret_cast<node*>(object);
+        n->next = local.head;
+        local.head = n;
+        if (++local.count > cache_limit) instance().give_back(local, cache_limit / 2);
+    }
+
+private:
+    union node {
+        node* next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    struct thread_cache {
+        node* head = nullptr;
+        std::size_t count = 0;
+
+        ~thread_cache() {
+            if (head) instance().give_back(*this, 0);
+        }
+    };
+
+    static constexpr std::size_t cache_limit = 256;
+    static constexpr std::size_t slab_count = 256;
+
+    static object_pool& instance() {
+        static object_pool* pool = new object_pool{};
+        return *pool;
+    }
+
+    static thread_cache& cache() {
+        thread_local thread_cache cache;
+        return cache;
+    }
+
+    // Moves all but keep objects of local to the shared list.
+    void give_back(thread_cache& local, std::size_t keep) noexcept {
+        node* first = local.head;
+        if (keep == 0) {
+            local.head = nullptr;
+        } else {
+            node* kept = local.head;
+            for (std::size_t i = 1; i < keep; ++i) kept = kept->next;
+            first = kept->next;
+            kept->next = nullptr;
+        }
+        local.count = keep;
+        if (!first) return;
+        node* last = first;
+        while (last->next) last = last->next;
+        std::lock_guard lock{mutex_};
+        last->next = shared_;
+        shared_ = first;
+    }
+
+    void refill(thread_cache& local) {
+        {
+            std::lock_guard lock{mutex_};
+            if (shared_) {
+                node* last = shared_;
+                std::size_t count = 1;
+                while (count < cache_limit / 2 && last->next) {
+                    last = last->next;
+                    ++count;
+                }
+                local.head = shared_;
+                shared_ = last->next;
+                last->next = nullptr;
+                local.count = count;
+                return;
+            }
+        }
+        // slabs stay in circulation for the lifetime of the process
+        auto* slab = new node[slab_count];
+        for (std::size_t i = 0; i < slab_count; ++i) slab[i].next = i + 1 < slab_count ? &slab[i + 1] : nullptr;
+        local.head = slab;
+        local.count = slab_count;
+    }
+
+    std::mutex mutex_;
+    node* shared_ = nullptr;
+};
+
+} // namespace nadi::detail
@@ -0,0 +1,53 @@
+#include "routing_table.hpp"
+
+#include <algorithm>
+
+namespace nadi::detail {
+
+routing_table::routing_table(std::vector<const node_instance*> nodes, std::vector<connection> connections, std::size_t abstract_node_count)
+    : nodes_{std::move(nodes)}, handles_(abstract_node_count), connections_{std::move(connections)} {
+    // stable sort keeps the connection order for fan-out within one route
+    std::vector<connection> sorted = connections_;
+    std::stable_sort(sorted.begin(), sorted.end(), [](const connection& a, const connection& b) { return a.source < b.source; });
+
+    node_routes_.assign(nodes_.size() + 1, 0);
+    destinations_.reserve(sorted.size());
+    std::size_t i = 0;
+    for (nadi_node_handle node = 0; node < nodes_.size(); ++node) {
+        node_routes_[node] = static_cast<std::uint32_t>(routes_.size());
+        for (; i < sorted.size() && sorted[i].source.node == node; ++i) {
+            if (routes_.size() == node_routes_[node] || routes_.back().channel != sorted[i].source.channel) {
+                auto begin = static_cast<std::uint32_t>(destinations_.size());
+                routes_.push_back({sorted[i].source.channel, begin, begin});
+            }
+            destinations_.push_back({sorted[i].destination.node, sorted[i].destination.channel, sorted[i].queue});
+            ++routes_.back().end;
+        }
+    }
+    node_routes_[nodes_.size()] = static_cast<std::uint32_t>(routes_.size());
+
+    for (nadi_node_handle handle = 0; handle < nodes_.size(); ++handle) {
+        if (nodes_[handle]) handles_[nodes_[handle]->abstract_node].emplace_back(nodes_[handle]->local, handle);
+    }
+    for (auto& list : handles_) std::sort(list.begin(), list.end());
+}
+
+std::span<const target> routing_table::destinations(nadi_node_handle node, unsigned int channel) const noexcept {
+    if (node >= nodes_.size()) return {};
+    const route* begin = routes_.data() + node_routes_[node];
+    const route* end = routes_.data() + node_routes_[node + 1];
+    // nodes rarely have more than a handful of connected outputs, a linear scan beats bisection there
+    for (const route* r = begin; r != end; ++r) {
+        if (r->channel == channel) return {destinations_.data() + r->begin, destinations_.data() + r->end};
+    }
+    return {};
+}
+
+nadi_node_handle routing_table::handle(std::size_t abstract_node, nadi_node_handle local) const noexcept {
+    if (abstract_node >= handles_.size()) return 0;
+    const auto& list = handles_[abstract_node];
+    auto it = std::lower_bound(list.begin(), list.end(), local, [](const auto& entry, nadi_node_handle key) { return entry.first < key; });
+    return it != list.end() && it->first == local ? it->second : 0;
+}
+
+} // namespace nadi::detail
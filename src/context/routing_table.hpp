@@ -0,0 +1,92 @@
+#pragma once
+
+#include "executor.hpp"
+#include "library.hpp"
+#include <nadi/nadi.h>
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace nadi::detail {
+
+struct endpoint {
+    nadi_node_handle node;
+    unsigned int channel;
+
+    auto operator<=>(const endpoint&) const = default;
+};
+
+class edge_queue;
+
+struct connection {
+    endpoint source;
+    endpoint destination;
+    edge_queue* queue = nullptr; // bounded connections only, owned by the context
+
+    bool operator==(const connection& other) const noexcept {
+        return source == other.source && destination == other.destination;
+    }
+};
+
+// Where a route leads: the destination endpoint and the queue of the connection, if bounded.
+struct target {
+    nadi_node_handle node;
+    unsigned int channel;
+    edge_queue* queue;
+};
+
+// Node created by the context from an abstract node. Handles given out by the context are
+// indices into its node list; local is the handle the library returned from nadi_create.
+struct node_instance {
+    node_instance(std::string name, std::size_t abstract_node, library& lib, nadi_node_handle local,
+                  std::size_t affinity = mailbox::no_affinity)
+        : name{std::move(name)}, abstract_node{abstract_node}, lib{&lib}, local{local}, inbox{lib, local, affinity} {}
+
+    std::string name;
+    std::size_t abstract_node;
+    library* lib;
+    nadi_node_handle local;
+    mutable mailbox inbox; // messages routed to the node, sent by a worker of the context's executor
+};
+
+// Immutable snapshot of the nodes and connections of a context. Routes are kept in flat arrays
+// indexed by source node and sorted by channel, so a lookup is a bounds check plus a short
+// search, without locks or allocation. A new table is built for every change and published
+// through an epoch, see epoch.hpp.
+class routing_table {
+public:
+    routing_table(std::vector<const node_instance*> nodes, std::vector<connection> connections, std::size_t abstract_node_count);
+
+    // Destinations of messages leaving node on channel, in connection order.
+    std::span<const target> destinations(nadi_node_handle node, unsigned int channel) const noexcept;
+
+    // Node with the given context handle, nullptr for the context itself or an unknown handle.
+    const node_instance* node(nadi_node_handle node) const noexcept {
+        return node < nodes_.size() ? nodes_[node] : nullptr;
+    }
+
+    // Context handle of the node created from abstract_node with the library handle local, 0 if unknown.
+    nadi_node_handle handle(std::size_t abstract_node, nadi_node_handle local) const noexcept;
+
+    const std::vector<connection>& connections() const noexcept { return connections_; }
+
+private:
+    struct route {
+        unsigned int channel;
+        std::uint32_t begin; // range in destinations_
+        std::uint32_t end;
+    };
+
+    std::vector<const node_instance*> nodes_;
+    std::vector<std::uint32_t> node_routes_; // routes_ of node i are [node_routes_[i], node_routes_[i + 1])
+    std::vector<route> routes_;
+    std::vector<target> destinations_;
+    std::vector<std::vector<std::pair<nadi_node_handle, nadi_node_handle>>> handles_; // per abstract node, sorted (local, handle)
+    std::vector<connection> connections_;
+};
+
+} // namespace nadi::detail
@@ -0,0 +1,64 @@
+#include "trampolines.hpp"
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+
+namespace nadi::detail {
+
+namespace {
+
+struct binding {
+    std::atomic<receive_target*> target{nullptr};
+    std::size_t abstract_node = 0;
+};
+
+std::array<binding, max_bindings> bindings;
+std::mutex bindings_mutex;
+
+template <std::size_t I>
+void receive_single(nadi_message* message) {
+    auto& b = bindings[I];
+    b.target.load(std::memory_order_acquire)->receive(b.abstract_node, &message, 1);
+}
+
+template <std::size_t I>
+void receive_batch(nadi_message** messages, std::size_t count) {
+    auto& b = bindings[I];
+    b.target.load(std::memory_order_acquire)->receive(b.abstract_node, messages, count);
+}
+
+template <std::size_t... I>
+constexpr std::array<nadi_receive_callback, sizeof...(I)> single_table(std::index_sequence<I...>) {
+    return {&receive_single<I>...};
+}
+
+template <std::size_t... I>
+constexpr std::array<nadi_receive_batch_callback, sizeof...(I)> batch_table(std::index_sequence<I...>) {
+    return {&receive_batch<I>...};
+}
+
+constexpr auto single_callbacks = single_table(std::make_index_sequence<max_bindings>{});
+constexpr auto batch_callbacks = batch_table(std::make_index_sequence<max_bindings>{});
+
+} // namespace
+
+receive_callbacks bind(receive_target& target, std::size_t abstract_node) {
+    std::lock_guard lock{bindings_mutex};
+    for (std::size_t i = 0; i < max_bindings; ++i) {
+        if (bindings[i].target.load(std::memory_order_relaxed)) continue;
+        bindings[i].abstract_node = abstract_node;
+        bindings[i].target.store(&target, std::memory_order_release);
+        return {i, single_callbacks[i], batch_callbacks[i]};
+    }
+    throw std::runtime_error{"too many NADI abstract nodes"};
+}
+
+void unbind(std::size_t binding) noexcept {
+    std::lock_guard lock{bindings_mutex};
+    bindings[binding].target.store(nullptr, std::memory_order_release);
+}
+
+} // namespace nadi::detail
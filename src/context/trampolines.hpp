@@ -0,0 +1,33 @@
+#pragma once
+
+#include <nadi/nadi.h>
+#include <cstddef>
+
+namespace nadi::detail {
+
+// Receives the upstream messages of all nodes created from one abstract node.
+class receive_target {
+public:
+    virtual void receive(std::size_t abstract_node, nadi_message** messages, std::size_t count) = 0;
+
+protected:
+    ~receive_target() = default;
+};
+
+// nadi_receive_callback carries no user data, so each abstract node of each context is bound to
+// its own pair of callbacks from a fixed table, which forward to the bound receive_target.
+inline constexpr std::size_t max_bindings = 256;
+
+struct receive_callbacks {
+    std::size_t binding;
+    nadi_receive_callback single;
+    nadi_receive_batch_callback batch;
+};
+
+// Throws std::runtime_error if all max_bindings callbacks are in use.
+receive_callbacks bind(receive_target& target, std::size_t abstract_node);
+
+// The callbacks must no longer be invoked, i.e. all nodes created with them are destroyed.
+void unbind(std::size_t binding) noexcept;
+
+} // namespace nadi::detail
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace nadi::detail {
+
+// Chase-Lev work-stealing deque (Lê et al., "Correct and Efficient Work-Stealing for Weak Memory
+// Models"). The owning thread pushes and pops at the bottom, any other thread steals from the
+// top. The array grows when full; replaced arrays are kept until destruction, as a concurrent
+// thief may still read from them.
+template <class T>
+class work_deque {
+public:
+    explicit work_deque(std::int64_t capacity = 64) : array_{new ring{capacity}} { rings_.emplace_back(array_.load()); }
+
+    work_deque(const work_deque&) = delete;
+    work_deque& operator=(const work_deque&) = delete;
+
+    // Owner only.
+    void push(T* item) {
+        std::int64_t bottom = bottom_.load(std::memory_order_relaxed);
+        std::int64_t top = top_.load(std::memory_order_acquire);
+        ring* r = array_.load(std::memory_order_relaxed);
+        if (bottom - top > r->capacity - 1) r = grow(r, bottom, top);
+        r->put(bottom, item);
+        bottom_.store(bottom + 1, std::memory_order_seq_cst); // ordered before checking for sleeping workers
+    }
+
+    // Owner only, newest item first.
+    T* pop() noexcept {
+        std::int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+        ring* r = array_.load(std::memory_order_relaxed);
+        bottom_.store(bottom, std::memory_order_seq_cst);
+        std::int64_t top = top_.load(std::memory_order_seq_cst);
+        if (top > bottom) {
+            bottom_.store(bottom + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        T* item = r->get(bottom);
+        if (top == bottom) {
+            // last item, race the thieves for it
+            if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) item = nullptr;
+            bottom_.store(bottom + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+    // Any thread, oldest item first. nullptr if empty or another thread won the race.
+    T* steal() noexcept {
+        std::int64_t top = top_.load(std::memory_order_seq_cst);
+        std::int64_t bottom = bottom_.load(std::memory_order_seq_cst);
+        if (top >= bottom) return nullptr;
+        T* item = array_.load(std::memory_order_acquire)->get(top);
+        if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) return nullptr;
+        return item;
+    }
+
+    bool empty() const noexcept { return bottom_.load(std::memory_order_seq_cst) <= top_.load(std::memory_order_seq_cst); }
+
+private:
+    struct ring {
+        explicit ring(std::int64_t capacity) : capacity{capacity}, slots{new std::atomic<T*>[static_cast<std::size_t>(capacity)]} {}
+
+        T* get(std::int64_t i) const noexcept { return slots[i & (capacity - 1)].load(std::memory_order_relaxed); }
+        void put(std::int64_t i, T* item) noexcept { slots[i & (capacity - 1)].store(item, std::memory_order_relaxed); }
+
+        std::int64_t capacity; // power of two
+        std::unique_ptr<std::atomic<T*>[]> slots;
+    };
+
+    ring* grow(ring* old, std::int64_t bottom, std::int64_t top) {
+        auto* bigger = new ring{old->capacity * 2};
+        rings_.emplace_back(bigger);
+        for (std::int64_t i = top; i < bottom; ++i) bigger->put(i, old->get(i));
+        array_.store(bigger, std::memory_order_release);
+        return bigger;
+    }
+
+    std::atomic<std::int64_t> top_{0};
+    std::atomic<std::int64_t> bottom_{0};
+    std::atomic<ring*> array_;
+    std::vector<std::unique_ptr<ring>> rings_; // owner only
+};
+
+} // namespace nadi::detail
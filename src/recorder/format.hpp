@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+namespace nadi::recorder {
+
+// A recording is a directory of numbered segments, each a pair of files:
+//   segment-000000.nadirec  file_header, then one record per message
+//   segment-000000.nadiidx  file_header, then index entries
+// Both are preallocated and written through a shared mapping. committed is stored after every
+// record, so a reader, even one opening a segment that is still being recorded, never looks past
+// the last complete record. A finished segment is truncated to committed. All integers are in
+// host byte order.
+
+inline constexpr std::uint64_t segment_magic = 0x314345524944414E; // "NADIREC1"
+inline constexpr std::uint64_t index_magic = 0x315844494944414E;   // "NADIIDX1"
+inline constexpr std::uint32_t format_version = 1;
+inline constexpr std::size_t record_alignment = 8;
+
+struct file_header {
+    std::uint64_t magic;
+    std::uint32_t version;
+    std::uint32_t finished;  // set once the recorder moved on, nothing is appended after that
+    std::uint64_t sequence;  // number of the segment within the recording
+    std::uint64_t committed; // end of the last complete record or entry, from the start of the file
+    std::uint64_t count;     // records or entries up to committed
+};
+
+// Followed by the null-terminated meta and, at the next record_alignment boundary, the data. The
+// next record starts at the next boundary after the data.
+struct record_header {
+    std::uint64_t timestamp;   // nanoseconds since the Unix epoch, taken when the recorder got the message
+    std::uint64_t node;        // sender
+    std::uint64_t meta_hash;
+    std::uint64_t data_length;
+    std::uint32_t channel;
+    std::uint32_t meta_length; // including the null terminator
+};
+
+// One entry for the first record at or after every index_interval bytes of a segment, in
+// timestamp order as far as the clock did not step back.
+struct index_entry {
+    std::uint64_t timestamp;
+    std::uint64_t offset; // of the record, from the start of the segment file
+};
+
+constexpr std::uint64_t align_record(std::uint64_t size) {
+    return (size + record_alignment - 1) & ~std::uint64_t{record_alignment - 1};
+}
+
+// Offset of the data from the start of its record.
+constexpr std::uint64_t data_offset(std::uint32_t meta_length) {
+    return align_record(sizeof(record_header) + meta_length);
+}
+
+constexpr std::uint64_t record_size(std::uint32_t meta_length, std::uint64_t data_length) {
+    return align_record(data_offset(meta_length) + data_length);
+}
+
+inline std::string segment_name(std::uint64_t sequence, const char* extension) {
+    char name[48];
+    std::snprintf(name, sizeof(name), "segment-%06llu.%s", static_cast<unsigned long long>(sequence), extension);
+    return name;
+}
+
+} // namespace nadi::recorder
@@ -0,0 +1,374 @@
+// nadi_recorder: NADI node persisting every message it receives, for nadi_replay or offline
+// analysis. Records are appended to preallocated segment files through a shared mapping, so
+// recording costs copies but no system call per message, and the kernel writes the pages back on
+// its own schedule. The layout is described in format.hpp.
+
+#include "format.hpp"
+
+#include <nadi/descriptor_builder.hpp>
+#include <nadi/message_pool.hpp>
+#include <nadi/meta_registry.hpp>
+#include <nadi/nadi.h>
+#include <nadi/segmented_message.hpp>
+#include <nadi/send_batch.hpp>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace nadi::recorder {
+
+namespace {
+
+constexpr unsigned int configuration_channel = 0xF100;
+constexpr std::uint64_t default_segment_size = 256ull << 20;
+constexpr std::uint64_t default_index_interval = 64 << 10;
+
+const descriptor node_descriptor =
+    descriptor_builder{"1.0.0"}
+        .description("Records every message sent to an input channel other than 0xF100 into memory-mapped segment files "
+                     "with a sidecar index. Connect the channels to record to it.")
+        .input(configuration_channel, "configuration", {"json"}, "recorder.open starts a recording, recorder.close ends it")
+        .output(configuration_channel, "configuration", {"json"}, "recorder.open.confirm, recorder.close.confirm and recorder.closed")
+        .feature("send batch")
+        .feature("segmented messages")
+        .feature("extended messages")
+        .build();
+
+// File preallocated to its full size and written through a shared mapping.
+class mapped_file {
+public:
+    mapped_file() = default;
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+    ~mapped_file() { finish(); }
+
+    bool open(const std::filesystem::path& path, std::uint64_t magic, std::uint64_t sequence, std::uint64_t size) {
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (fd < 0) return false;
+        // reserves the blocks now, so a full disk fails here instead of as SIGBUS on a store
+        void* data = posix_fallocate(fd, 0, static_cast<off_t>(size)) == 0
+                         ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+                         : MAP_FAILED;
+        if (data == MAP_FAILED) {
+            ::close(fd);
+            unlink(path.c_str());
+            return false;
+        }
+        fd_ = fd;
+        data_ = static_cast<std::byte*>(data);
+        size_ = size;
+        header() = {magic, format_version, 0, sequence, sizeof(file_header), 0};
+        return true;
+    }
+
+    // Marks the file finished, unmaps it and truncates it to what was committed. If truncating
+    // fails, the file keeps its preallocated size, which readers skip by going by committed.
+    bool finish() noexcept {
+        if (!data_) return true;
+        std::atomic_ref{header().finished}.store(1, std::memory_order_release);
+        std::uint64_t committed = header().committed;
+        munmap(data_, size_);
+        bool truncated = ftruncate(fd_, static_cast<off_t>(committed)) == 0;
+        ::close(fd_);
+        data_ = nullptr;
+        return truncated;
+    }
+
+    explicit operator bool() const noexcept { return data_ != nullptr; }
+
+    file_header& header() noexcept { return *reinterpret_cast<file_header*>(data_); }
+    std::byte* data() noexcept { return data_; }
+    std::uint64_t size() const noexcept { return size_; }
+
+    // Publishes everything up to committed.
+    void commit(std::uint64_t committed, std::uint64_t count) noexcept {
+        header().count = count;
+        std::atomic_ref{header().committed}.store(committed, std::memory_order_release);
+    }
+
+private:
+    int fd_ = -1;
+    std::byte* data_ = nullptr;
+    std::uint64_t size_ = 0;
+};
+
+class recorder {
+public:
+    recorder(nadi_node_handle handle, nadi_receive_callback receive) noexcept : handle_{handle}, receive_{receive} {}
+
+    void send(nadi_message** messages, std::size_t count, nadi_status* statuses) {
+        std::size_t begin = 0;
+        while (begin < count) {
+            if (messages[begin]->channel == configuration_channel) {
+                statuses[begin] = configure(messages[begin]);
+                ++begin;
+                continue;
+            }
+            std::size_t end = begin;
+            while (end < count && messages[end]->channel != configuration_channel) ++end;
+            write(messages + begin, end - begin, statuses + begin);
+            begin = end;
+        }
+    }
+
+    // Finishes the recording and deletes the recorder.
+    void stop() {
+        {
+            std::lock_guard lock{mutex_};
+            close();
+        }
+        delete this;
+    }
+
+private:
+    nadi_status configure(nadi_message* message) {
+        if (is_segmented(*message)) return NADI_INVALID_MESSAGE;
+        auto text = payload_view(*message);
+        auto request = nlohmann::json::parse(text.begin(), text.end(), nullptr, false);
+        auto type = request.is_object() ? request.find("type") : request.end();
+        if (type == request.end() || (*type != "recorder.open" && *type != "recorder.close")) return NADI_INVALID_MESSAGE;
+        std::string id;
+        if (auto it = request.find("id"); it != request.end() && it->is_string()) id = it->get<std::string>();
+        message->free(message);
+        std::string error;
+        nlohmann::json totals;
+        {
+            std::lock_guard lock{mutex_};
+            if (*type == "recorder.open") {
+                error = records_ ? "already recording" : open(request);
+            } else if (!records_) {
+                error = "not recording";
+            } else {
+                totals = {{"records", total_records_}, {"segments", sequence_ - first_sequence_ + 1}};
+                close();
+            }
+        }
+        respond(*type == "recorder.open" ? "recorder.open.confirm" : "recorder.close.confirm", id, error, std::move(totals));
+        return NADI_OK;
+    }
+
+    // Requires mutex_. Returns an error text, empty on success.
+    std::string open(const nlohmann::json& request) {
+        auto directory = request.find("directory");
+        if (directory == request.end() || !directory->is_string() || directory->get_ref<const std::string&>().empty()) {
+            return "directory must be a path";
+        }
+        auto segment_size = request.find("segment_size");
+        if (segment_size != request.end() && (!segment_size->is_number_unsigned() || segment_size->get<std::uint64_t>() < (1 << 20))) {
+            return "segment_size must be an integer of at least 1048576";
+        }
+        auto index_interval = request.find("index_interval");
+        if (index_interval != request.end() && (!index_interval->is_number_unsigned() || index_interval->get<std::uint64_t>() == 0)) {
+            return "index_interval must be a positive integer";
+        }
+        segment_size_ = segment_size != request.end() ? segment_size->get<std::uint64_t>() : default_segment_size;
+        index_interval_ = index_interval != request.end() ? index_interval->get<std::uint64_t>() : default_index_interval;
+
+        directory_ = directory->get<std::string>();
+        std::error_code error;
+        std::filesystem::create_directories(directory_, error);
+        if (error) return "cannot create " + directory_.string();
+        // a recording continues after the segments already in the directory
+        sequence_ = 0;
+        for (const auto& entry : std::filesystem::directory_iterator{directory_, error}) {
+            std::string name = entry.path().filename().string();
+            std::uint64_t sequence;
+            if (name.starts_with("segment-") && name.ends_with(".nadirec") &&
+                std::from_chars(name.data() + 8, name.data() + name.size(), sequence).ec == std::errc{}) {
+                sequence_ = std::max(sequence_, sequence + 1);
+            }
+        }
+        first_sequence_ = sequence_;
+        total_records_ = 0;
+        if (!start_segment(0)) return "cannot create a segment in " + directory_.string();
+        return {};
+    }
+
+    // Requires mutex_.
+    void close() noexcept {
+        records_.finish();
+        index_.finish();
+    }
+
+    // Requires mutex_. Starts the segment sequence_, large enough for a record of record bytes.
+    bool start_segment(std::uint64_t record) {
+        std::uint64_t size = std::max(segment_size_, sizeof(file_header) + record);
+        std::uint64_t entries = size / index_interval_ + 2;
+        if (!records_.open(directory_ / segment_name(sequence_, "nadirec"), segment_magic, sequence_, size)) return false;
+        if (!index_.open(directory_ / segment_name(sequence_, "nadiidx"), index_magic, sequence_,
+                         sizeof(file_header) + entries * sizeof(index_entry))) {
+            records_.finish();
+            return false;
+        }
+        position_ = sizeof(file_header);
+        next_index_ = position_;
+        records_in_segment_ = 0;
+        index_end_ = sizeof(file_header);
+        index_count_ = 0;
+        return true;
+    }
+
+    void write(nadi_message** messages, std::size_t count, nadi_status* statuses) {
+        std::string error;
+        std::unique_lock lock{mutex_};
+        for (std::size_t i = 0; i < count; ++i) {
+            if (!records_) {
+                std::fill(statuses + i, statuses + count, NADI_NOT_INITIALIZED);
+                break;
+            }
+            const nadi_message& message = *messages[i];
+            const char* meta = message.meta ? message.meta : "";
+            auto meta_length = static_cast<std::uint32_t>(std::strlen(meta) + 1);
+            std::uint64_t length = payload_length(message);
+            std::uint64_t size = record_size(meta_length, length);
+            if (position_ + size > records_.size()) {
+                records_.finish();
+                index_.finish();
+                ++sequence_;
+                if (!start_segment(size)) {
+                    error = "cannot create a segment in " + directory_.string();
+                    std::fill(statuses + i, statuses + count, NADI_NOT_INITIALIZED);
+                    break;
+                }
+            }
+            std::uint64_t timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                          std::chrono::system_clock::now().time_since_epoch()).count();
+            std::byte* record = records_.data() + position_;
+            record_header header{timestamp, message.node, message.meta_hash ? message.meta_hash : nadi_meta_hash(meta),
+                                 length, message.channel, meta_length};
+            std::memcpy(record, &header, sizeof(header));
+            std::memcpy(record + sizeof(header), meta, meta_length);
+            copy_payload(message, record + data_offset(meta_length)); // padding is left zero from preallocation
+            if (position_ >= next_index_ && index_end_ + sizeof(index_entry) <= index_.size()) {
+                index_entry entry{timestamp, position_};
+                std::memcpy(index_.data() + index_end_, &entry, sizeof(entry));
+                index_end_ += sizeof(entry);
+                index_.commit(index_end_, ++index_count_);
+                next_index_ = position_ + index_interval_;
+            }
+            position_ += size;
+            records_.commit(position_, ++records_in_segment_);
+            ++total_records_;
+            statuses[i] = NADI_OK;
+            messages[i]->free(messages[i]);
+        }
+        lock.unlock();
+        // outside the lock, the response may be routed straight back to this node
+        if (!error.empty()) respond("recorder.closed", {}, error, {});
+    }
+
+    void respond(std::string_view type, const std::string& id, const std::string& error, nlohmann::json fields) {
+        static const interned_meta json = meta_registry::instance().intern("json");
+        nlohmann::json response{{"type", type}, {"status", error.empty() ? "success" : "error"}};
+        if (!error.empty()) response["error"] = error;
+        if (!id.empty()) response["id"] = id;
+        if (fields.is_object()) response.update(fields);
+        std::string text = response.dump();
+        nadi_message* message = message_pool::instance().allocate(json, text.size() + 1);
+        std::memcpy(message->data, text.c_str(), text.size() + 1);
+        message->channel = configuration_channel;
+        message->node = handle_;
+        receive_(message);
+    }
+
+    const nadi_node_handle handle_;
+    const nadi_receive_callback receive_;
+    std::mutex mutex_; // records of concurrent senders must not interleave
+    std::filesystem::path directory_;
+    std::uint64_t segment_size_ = default_segment_size;
+    std::uint64_t index_interval_ = default_index_interval;
+    mapped_file records_;
+    mapped_file index_;
+    std::uint64_t sequence_ = 0;
+    std::uint64_t first_sequence_ = 0;
+    std::uint64_t position_ = 0;   // end of the last record in records_
+    std::uint64_t next_index_ = 0; // the first record from here on gets an index entry
+    std::uint64_t records_in_segment_ = 0;
+    std::uint64_t index_end_ = 0;
+    std::uint64_t index_count_ = 0;
+    std::uint64_t total_records_ = 0;
+};
+
+std::shared_mutex recorders_mutex;
+std::unordered_map<nadi_node_handle, recorder*> recorders;
+nadi_node_handle next_handle = 1;
+
+} // namespace
+
+} // namespace nadi::recorder
+
+extern "C" {
+
+DLL_EXPORT nadi_status nadi_create(nadi_node_handle* node, nadi_receive_callback receive_callback) {
+    using namespace nadi::recorder;
+    if (!node || !receive_callback) return NADI_INVALID_MESSAGE;
+    std::lock_guard lock{recorders_mutex};
+    *node = next_handle++;
+    recorders.emplace(*node, new recorder{*node, receive_callback});
+    return NADI_OK;
+}
+
+DLL_EXPORT nadi_status nadi_destroy(nadi_node_handle node) {
+    using namespace nadi::recorder;
+    recorder* instance = nullptr;
+    {
+        std::lock_guard lock{recorders_mutex};
+        auto it = recorders.find(node);
+        if (it == recorders.end()) return NADI_INVALID_NODE;
+        instance = it->second;
+        recorders.erase(it);
+    }
+    instance->stop();
+    return NADI_OK;
+}
+
+DLL_EXPORT nadi_status nadi_send(nadi_message* message, nadi_node_handle node) {
+    using namespace nadi::recorder;
+    if (!message) return NADI_INVALID_MESSAGE;
+    std::shared_lock lock{recorders_mutex};
+    auto it = recorders.find(node);
+    if (it == recorders.end()) return NADI_INVALID_NODE;
+    nadi_status status;
+    it->second->send(&message, 1, &status);
+    return status;
+}
+
+DLL_EXPORT nadi_status nadi_send_batch(nadi_message** messages, size_t count, nadi_node_handle node, nadi_status* statuses,
+                                       size_t* accepted) {
+    using namespace nadi::recorder;
+    if (!accepted) return NADI_INVALID_MESSAGE;
+    *accepted = 0;
+    if (!messages || !statuses) return NADI_INVALID_MESSAGE;
+    std::shared_lock lock{recorders_mutex};
+    auto it = recorders.find(node);
+    if (it == recorders.end()) return NADI_INVALID_NODE;
+    it->second->send(messages, count, statuses);
+    return nadi::batch_status(statuses, count, accepted);
+}
+
+DLL_EXPORT void nadi_free(nadi_message* message) {
+    message->free(message);
+}
+
+DLL_EXPORT nadi_status nadi_descriptor(char* buffer, size_t* length) {
+    return nadi::recorder::node_descriptor.write(buffer, length);
+}
+
+DLL_EXPORT nadi_status nadi_descriptor_view(const char** descriptor, size_t* length) {
+    return nadi::recorder::node_descriptor.view(descriptor, length);
+}
+
+} // extern "C"
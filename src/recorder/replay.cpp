@@ -0,0 +1,482 @@
+// nadi_replay: NADI node replaying recordings of nadi_recorder. Records are emitted on the output
+// channel they were recorded on, with meta and data pointing straight into a read-only mapping of
+// their segment, either as fast as the graph takes them or spaced as they were recorded, scaled
+// by a speed factor. Seeking uses the sidecar indexes described in format.hpp.
+
+#include "format.hpp"
+
+#include <nadi/descriptor_builder.hpp>
+#include <nadi/extended_message.hpp>
+#include <nadi/message_pool.hpp>
+#include <nadi/meta_registry.hpp>
+#include <nadi/nadi.h>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <shared_mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace nadi::recorder {
+
+namespace {
+
+constexpr unsigned int configuration_channel = 0xF100;
+constexpr std::size_t max_batch = 256;
+
+const descriptor node_descriptor =
+    descriptor_builder{"1.0.0"}
+        .description("Replays a recording of nadi_recorder, emitting every record on the output channel it was recorded on.")
+        .input(configuration_channel, "configuration", {"json"}, "replay.open, replay.play, replay.pause, replay.seek and replay.close")
+        .output(configuration_channel, "configuration", {"json"}, "confirmations and replay.finished")
+        .feature("receive batch")
+        .build();
+
+// Read-only mapping of a whole segment or index file, kept until the last replayed message
+// pointing into it is freed.
+class mapping {
+public:
+    // nullptr if the file cannot be mapped or is not of the expected kind.
+    static mapping* open(const std::filesystem::path& path, std::uint64_t magic) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return nullptr;
+        struct stat info;
+        void* data = fstat(fd, &info) == 0 && static_cast<std::uint64_t>(info.st_size) >= sizeof(file_header)
+                         ? mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0)
+                         : MAP_FAILED;
+        ::close(fd);
+        if (data == MAP_FAILED) return nullptr;
+        auto* self = new mapping{static_cast<const std::byte*>(data), static_cast<std::uint64_t>(info.st_size)};
+        if (self->header().magic != magic || self->header().version != format_version) {
+            self->unref();
+            return nullptr;
+        }
+        return self;
+    }
+
+    const file_header& header() const noexcept { return *reinterpret_cast<const file_header*>(data_); }
+    const std::byte* data() const noexcept { return data_; }
+
+    // End of what the recorder committed so far, which grows while it is still recording.
+    std::uint64_t committed() const noexcept {
+        std::uint64_t committed = std::atomic_ref{const_cast<std::uint64_t&>(header().committed)}.load(std::memory_order_acquire);
+        return std::clamp<std::uint64_t>(committed, sizeof(file_header), size_);
+    }
+
+    void ref() noexcept { references_.fetch_add(1, std::memory_order_relaxed); }
+
+    void unref() noexcept {
+        if (references_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            munmap(const_cast<std::byte*>(data_), size_);
+            delete this;
+        }
+    }
+
+private:
+    mapping(const std::byte* data, std::uint64_t size) noexcept : data_{data}, size_{size} {}
+    ~mapping() = default;
+
+    const std::byte* data_;
+    std::uint64_t size_;
+    std::atomic<std::int64_t> references_{1};
+};
+
+// Message pointing into a segment. The mapping is read-only, like any payload is to receivers.
+struct replayed_message {
+    nadi_message message;
+    nadi_extended_payload extended; // payload of records of 4 GiB and more
+    mapping* segment;
+
+    static void free(nadi_message* message) {
+        auto* self = reinterpret_cast<replayed_message*>(message);
+        self->segment->unref();
+        delete self;
+    }
+};
+
+struct segment {
+    std::filesystem::path path;
+    mapping* index = nullptr;   // mapped while the recording is open
+    mapping* records = nullptr; // mapped while being replayed
+    std::uint64_t first_timestamp = 0;
+
+    std::span<const index_entry> entries() const noexcept {
+        return {reinterpret_cast<const index_entry*>(index->data() + sizeof(file_header)),
+                (index->committed() - sizeof(file_header)) / sizeof(index_entry)};
+    }
+};
+
+// The complete record at offset, nullptr at the end of what was committed or if it is damaged.
+const record_header* record_at(const mapping& records, std::uint64_t offset) {
+    std::uint64_t end = records.committed();
+    if (offset > end || end - offset < sizeof(record_header)) return nullptr;
+    const auto* record = reinterpret_cast<const record_header*>(records.data() + offset);
+    if (record->meta_length == 0 || record->data_length > end || record_size(record->meta_length, record->data_length) > end - offset ||
+        records.data()[offset + sizeof(record_header) + record->meta_length - 1] != std::byte{0}) {
+        return nullptr;
+    }
+    return record;
+}
+
+class player {
+public:
+    player(nadi_node_handle handle, nadi_receive_callback receive, nadi_receive_batch_callback receive_batch) noexcept
+        : handle_{handle}, receive_{receive}, receive_batch_{receive_batch} {}
+
+    nadi_status send(nadi_message* message) {
+        if (message->channel != configuration_channel) return NADI_INVALID_CHANNEL;
+        return configure(message);
+    }
+
+    // Stops replaying and deletes the player; messages still held by receivers keep their mapping.
+    void stop() {
+        {
+            std::lock_guard lock{mutex_};
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        if (thread_.joinable()) thread_.join();
+        {
+            std::lock_guard lock{mutex_};
+            close();
+        }
+        delete this;
+    }
+
+private:
+    nadi_status configure(nadi_message* message) {
+        auto text = payload_view(*message);
+        auto request = nlohmann::json::parse(text.begin(), text.end(), nullptr, false);
+        auto type_field = request.is_object() ? request.find("type") : request.end();
+        if (type_field == request.end() || !type_field->is_string()) return NADI_INVALID_MESSAGE;
+        std::string type = type_field->get<std::string>();
+        if (type != "replay.open" && type != "replay.play" && type != "replay.pause" && type != "replay.seek" && type != "replay.close") {
+            return NADI_INVALID_MESSAGE;
+        }
+        std::string id;
+        if (auto it = request.find("id"); it != request.end() && it->is_string()) id = it->get<std::string>();
+        message->free(message);
+        std::string error;
+        nlohmann::json fields;
+        {
+            std::lock_guard lock{mutex_};
+            if (type == "replay.open") {
+                error = !segments_.empty() ? "already open" : open(request, fields);
+                if (error.empty() && !thread_.joinable()) thread_ = std::thread{[this] { run(); }};
+            } else if (segments_.empty()) {
+                error = "not open";
+            } else if (type == "replay.play") {
+                auto speed = request.find("speed");
+                if (speed != request.end() && (!speed->is_number() || speed->get<double>() < 0)) {
+                    error = "speed must be a number of at least 0";
+                } else {
+                    speed_ = speed != request.end() ? speed->get<double>() : 1.0;
+                    playing_ = true;
+                    rebase_ = true;
+                }
+            } else if (type == "replay.pause") {
+                playing_ = false;
+            } else if (type == "replay.seek") {
+                auto timestamp = request.find("timestamp");
+                if (timestamp == request.end() || !timestamp->is_number_unsigned()) {
+                    error = "timestamp must be nanoseconds since the Unix epoch";
+                } else {
+                    seek(timestamp->get<std::uint64_t>());
+                    rebase_ = true;
+                    if (const record_header* record = peek()) fields["timestamp"] = record->timestamp;
+                }
+            } else {
+                close();
+            }
+        }
+        wake_.notify_all();
+        respond(type + ".confirm", id, error, std::move(fields));
+        return NADI_OK;
+    }
+
+    // Requires mutex_. Returns an error text, empty on success.
+    std::string open(const nlohmann::json& request, nlohmann::json& fields) {
+        auto directory = request.find("directory");
+        if (directory == request.end() || !directory->is_string()) return "directory must be a path";
+        std::filesystem::path path = directory->get<std::string>();
+        std::vector<std::uint64_t> sequences;
+        std::error_code error;
+        for (const auto& entry : std::filesystem::directory_iterator{path, error}) {
+            std::string name = entry.path().filename().string();
+            std::uint64_t sequence;
+            if (name.starts_with("segment-") && name.ends_with(".nadirec") &&
+                std::from_chars(name.data() + 8, name.data() + name.size(), sequence).ec == std::errc{}) {
+                sequences.push_back(sequence);
+            }
+        }
+        std::sort(sequences.begin(), sequences.end());
+        for (std::uint64_t sequence : sequences) {
+            segment s{path / segment_name(sequence, "nadirec")};
+            s.index = mapping::open(path / segment_name(sequence, "nadiidx"), index_magic);
+            // the first record of a segment always has an index entry, so an empty index means no records
+            if (!s.index || s.entries().empty()) {
+                if (s.index) s.index->unref();
+                continue;
+            }
+            s.first_timestamp = s.entries().front().timestamp;
+            segments_.push_back(std::move(s));
+        }
+        if (segments_.empty()) return "no recording in " + path.string();
+        current_ = 0;
+        offset_ = sizeof(file_header);
+        playing_ = false;
+        fields = {{"segments", segments_.size()}, {"begin", segments_.front().first_timestamp}, {"end", last_timestamp()}};
+        return {};
+    }
+
+    // Requires mutex_.
+    void close() noexcept {
+        for (auto& s : segments_) {
+            s.index->unref();
+            if (s.records) s.records->unref();
+        }
+        segments_.clear();
+        playing_ = false;
+    }
+
+    // Requires mutex_. Timestamp of the last record, found from the last index entry.
+    std::uint64_t last_timestamp() {
+        const segment& last = segments_.back();
+        mapping* records = mapping::open(last.path, segment_magic);
+        std::uint64_t timestamp = last.entries().back().timestamp;
+        if (!records) return timestamp;
+        std::uint64_t offset = last.entries().back().offset;
+        while (const record_header* record = record_at(*records, offset)) {
+            timestamp = record->timestamp;
+            offset += record_size(record->meta_length, record->data_length);
+        }
+        records->unref();
+        return timestamp;
+    }
+
+    // Requires mutex_. The record at the cursor, moving on to the next segment at the end of one,
+    // or nullptr at the end of the recording.
+    const record_header* peek() {
+        while (current_ < segments_.size()) {
+            segment& s = segments_[current_];
+            if (!s.records) s.records = mapping::open(s.path, segment_magic);
+            if (s.records) {
+                if (const record_header* record = record_at(*s.records, offset_)) return record;
+                s.records->unref();
+                s.records = nullptr;
+            }
+            ++current_;
+            offset_ = sizeof(file_header);
+        }
+        return nullptr;
+    }
+
+    // Requires mutex_.
+    void move_to(std::size_t index, std::uint64_t offset) {
+        if (index != current_ && current_ < segments_.size() && segments_[current_].records) {
+            segments_[current_].records->unref();
+            segments_[current_].records = nullptr;
+        }
+        current_ = index;
+        offset_ = offset;
+    }
+
+    // Requires mutex_. Moves the cursor to the first record at or after timestamp: binary searches
+    // over the segments and over the index of one, then a scan of at most one index interval.
+    void seek(std::uint64_t timestamp) {
+        auto after = std::upper_bound(segments_.begin(), segments_.end(), timestamp,
+                                      [](std::uint64_t t, const segment& s) { return t < s.first_timestamp; });
+        std::size_t index = after == segments_.begin() ? 0 : static_cast<std::size_t>(after - segments_.begin()) - 1;
+        auto entries = segments_[index].entries();
+        auto entry = std::upper_bound(entries.begin(), entries.end(), timestamp,
+                                      [](std::uint64_t t, const index_entry& e) { return t < e.timestamp; });
+        move_to(index, entry == entries.begin() ? sizeof(file_header) : std::prev(entry)->offset);
+        while (const record_header* record = peek()) {
+            if (record->timestamp >= timestamp) break;
+            offset_ += record_size(record->meta_length, record->data_length);
+        }
+    }
+
+    // Requires mutex_. When record is due at speed_ > 0, relative to where playing started.
+    std::chrono::steady_clock::time_point due(const record_header& record) {
+        if (rebase_) {
+            base_time_ = std::chrono::steady_clock::now();
+            base_timestamp_ = record.timestamp;
+            rebase_ = false;
+        }
+        if (record.timestamp <= base_timestamp_) return base_time_;
+        std::chrono::duration<double, std::nano> delay{static_cast<double>(record.timestamp - base_timestamp_) / speed_};
+        return base_time_ + std::chrono::duration_cast<std::chrono::steady_clock::duration>(delay);
+    }
+
+    // Requires mutex_. Message for the record at the cursor, which it then moves past.
+    nadi_message* take(const record_header& record) {
+        mapping* records = segments_[current_].records;
+        const auto* bytes = reinterpret_cast<const std::byte*>(&record);
+        void* data = const_cast<std::byte*>(bytes + data_offset(record.meta_length));
+        auto* replayed = new replayed_message{};
+        replayed->message.meta = reinterpret_cast<const char*>(bytes + sizeof(record_header));
+        replayed->message.meta_hash = record.meta_hash;
+        if (record.data_length >= NADI_EXTENDED) {
+            replayed->extended = {data, record.data_length};
+            replayed->message.data = &replayed->extended;
+            replayed->message.data_length = NADI_EXTENDED;
+        } else {
+            replayed->message.data = data;
+            replayed->message.data_length = static_cast<unsigned int>(record.data_length);
+        }
+        replayed->message.channel = record.channel;
+        replayed->message.free = &replayed_message::free;
+        replayed->message.node = handle_;
+        replayed->segment = records;
+        records->ref();
+        offset_ += record_size(record.meta_length, record.data_length);
+        return &replayed->message;
+    }
+
+    void run() {
+        std::vector<nadi_message*> batch;
+        std::unique_lock lock{mutex_};
+        while (!stopping_) {
+            const record_header* record = playing_ ? peek() : nullptr;
+            if (record && (speed_ == 0 || due(*record) <= std::chrono::steady_clock::now())) {
+                batch.push_back(take(*record));
+                if (batch.size() < max_batch) continue;
+            }
+            // nothing more to take right now: hand the batch over, then wait for the next record
+            if (!batch.empty()) {
+                lock.unlock();
+                emit(batch);
+                batch.clear();
+                lock.lock();
+            } else if (record) {
+                wake_.wait_until(lock, due(*record));
+            } else if (playing_) {
+                playing_ = false;
+                lock.unlock();
+                respond("replay.finished", {}, {}, {});
+                lock.lock();
+            } else {
+                wake_.wait(lock);
+            }
+        }
+        for (nadi_message* message : batch) message->free(message);
+    }
+
+    void emit(std::vector<nadi_message*>& batch) {
+        if (batch.size() > 1 && receive_batch_) {
+            receive_batch_(batch.data(), batch.size());
+        } else {
+            for (nadi_message* message : batch) receive_(message);
+        }
+    }
+
+    void respond(std::string_view type, const std::string& id, const std::string& error, nlohmann::json fields) {
+        static const interned_meta json = meta_registry::instance().intern("json");
+        nlohmann::json response{{"type", type}, {"status", error.empty() ? "success" : "error"}};
+        if (!error.empty()) response["error"] = error;
+        if (!id.empty()) response["id"] = id;
+        if (fields.is_object()) response.update(fields);
+        std::string text = response.dump();
+        nadi_message* message = message_pool::instance().allocate(json, text.size() + 1);
+        std::memcpy(message->data, text.c_str(), text.size() + 1);
+        message->channel = configuration_channel;
+        message->node = handle_;
+        receive_(message);
+    }
+
+    const nadi_node_handle handle_;
+    const nadi_receive_callback receive_;
+    const nadi_receive_batch_callback receive_batch_;
+    std::mutex mutex_;
+    std::condition_variable wake_; // on every command and on stop
+    std::vector<segment> segments_; // with records, empty while no recording is open
+    std::size_t current_ = 0;       // cursor: segment and offset of the next record
+    std::uint64_t offset_ = 0;
+    bool playing_ = false;
+    double speed_ = 1.0;            // 0 replays as fast as possible
+    bool rebase_ = true;            // the next due() starts timing from its record
+    std::chrono::steady_clock::time_point base_time_;
+    std::uint64_t base_timestamp_ = 0;
+    bool stopping_ = false;
+    std::thread thread_;
+};
+
+std::shared_mutex players_mutex;
+std::unordered_map<nadi_node_handle, player*> players;
+nadi_node_handle next_handle = 1;
+
+nadi_status create(nadi_node_handle* node, nadi_receive_callback receive, nadi_receive_batch_callback receive_batch) {
+    if (!node || !receive) return NADI_INVALID_MESSAGE;
+    std::lock_guard lock{players_mutex};
+    *node = next_handle++;
+    players.emplace(*node, new player{*node, receive, receive_batch});
+    return NADI_OK;
+}
+
+} // namespace
+
+} // namespace nadi::recorder
+
+extern "C" {
+
+DLL_EXPORT nadi_status nadi_create(nadi_node_handle* node, nadi_receive_callback receive_callback) {
+    return nadi::recorder::create(node, receive_callback, nullptr);
+}
+
+DLL_EXPORT nadi_status nadi_create_ex(nadi_node_handle* node, nadi_receive_callback receive_callback,
+                                      nadi_receive_batch_callback receive_batch_callback) {
+    return nadi::recorder::create(node, receive_callback, receive_batch_callback);
+}
+
+DLL_EXPORT nadi_status nadi_destroy(nadi_node_handle node) {
+    using namespace nadi::recorder;
+    player* instance = nullptr;
+    {
+        std::lock_guard lock{players_mutex};
+        auto it = players.find(node);
+        if (it == players.end()) return NADI_INVALID_NODE;
+        instance = it->second;
+        players.erase(it);
+    }
+    instance->stop();
+    return NADI_OK;
+}
+
+DLL_EXPORT nadi_status nadi_send(nadi_message* message, nadi_node_handle node) {
+    using namespace nadi::recorder;
+    if (!message) return NADI_INVALID_MESSAGE;
+    std::shared_lock lock{players_mutex};
+    auto it = players.find(node);
+    if (it == players.end()) return NADI_INVALID_NODE;
+    return it->second->send(message);
+}
+
+DLL_EXPORT void nadi_free(nadi_message* message) {
+    message->free(message);
+}
+
+DLL_EXPORT nadi_status nadi_descriptor(char* buffer, size_t* length) {
+    return nadi::recorder::node_descriptor.write(buffer, length);
+}
+
+DLL_EXPORT nadi_status nadi_descriptor_view(const char** descriptor, size_t* length) {
+    return nadi::recorder::node_descriptor.view(descriptor, length);
+}
+
+} // extern "C"
@@ -0,0 +1,347 @@
+// nadi_shm: NADI node bridging a graph to a peer process through a POSIX shared-memory segment.
+// Messages sent to the bridge are copied once into a slot of the outgoing ring; the peer's bridge
+// emits them with meta and data pointing straight into that slot, which is released when the
+// receiver frees the message. Idle endpoints sleep on a futex rung by the peer.
+
+#include "segment.hpp"
+
+#include <nadi/credit.hpp>
+#include <nadi/descriptor_builder.hpp>
+#include <nadi/message_pool.hpp>
+#include <nadi/meta_registry.hpp>
+#include <nadi/nadi.h>
+#include <nadi/segmented_message.hpp>
+#include <nlohmann/json.hpp>
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace nadi::shm {
+
+namespace {
+
+constexpr unsigned int configuration_channel = 0xF100;
+constexpr std::size_t data_alignment = 16;
+
+const descriptor node_descriptor =
+    descriptor_builder{"1.0.0"}
+        .description("Bridges to a peer process through POSIX shared memory. Messages sent to any input channel other than "
+                     "0xF100 leave the peer's bridge on the output channel with the same number.")
+        .input(configuration_channel, "configuration", {"json"}, "shm.open connects the bridge to a segment")
+        .output(configuration_channel, "configuration", {"json"}, "shm.open.confirm, and node.credit after NADI_WOULD_BLOCK")
+        .feature("segmented messages")
+        .feature("extended messages")
+        .build();
+
+class bridge;
+
+// Header of a message received in place, one per slot of the incoming ring.
+struct delivery {
+    nadi_message message;
+    bridge* owner;
+    std::uint64_t position;
+};
+
+class bridge {
+public:
+    bridge(nadi_node_handle handle, nadi_receive_callback receive) noexcept : handle_{handle}, receive_{receive} {}
+
+    ~bridge() {
+        if (segment_) munmap(segment_, size_);
+    }
+
+    nadi_status send(nadi_message* message) {
+        if (message->channel == configuration_channel) return configure(message);
+        std::unique_lock lock{send_mutex_};
+        if (!segment_) return NADI_NOT_INITIALIZED;
+        const char* meta = message->meta ? message->meta : "";
+        std::size_t meta_size = std::strlen(meta) + 1;
+        std::size_t data_offset = (sizeof(slot_header) + meta_size + data_alignment - 1) / data_alignment * data_alignment;
+        std::uint64_t length = payload_length(*message);
+        if (data_offset + length > out_.slot_size()) return NADI_INVALID_MESSAGE;
+
+        std::uint64_t position;
+        if (!out_.reserve(position)) {
+            // set before asking, so the reader thread cannot miss the wakeup for the free space
+            blocked_channel_.store(message->channel, std::memory_order_seq_cst);
+            if (out_.want_space()) return NADI_WOULD_BLOCK;
+            out_.reserve(position); // only this writer fills slots, so the space stays
+        }
+        std::byte* slot = out_.bytes(position);
+        out_.slot(position).fields = {message->meta_hash ? message->meta_hash : nadi_meta_hash(meta), length, message->channel,
+                                      static_cast<std::uint32_t>(data_offset)};
+        std::memcpy(slot + sizeof(slot_header), meta, meta_size);
+        copy_payload(*message, slot + data_offset); // gathers segmented payloads on the way
+        out_.commit(position);
+        ring(segment_->bells[1 - endpoint_]);
+        lock.unlock();
+        message->free(message);
+        return NADI_OK;
+    }
+
+    // Stops the reader thread and gives up the node's reference; messages still held by receivers
+    // keep the mapping alive.
+    void stop() {
+        stopping_.store(true, std::memory_order_seq_cst);
+        if (reader_.joinable()) {
+            ring(segment_->bells[endpoint_]);
+            reader_.join();
+        }
+        if (segment_ && endpoint_ == 0) shm_unlink(name_.c_str());
+        unref();
+    }
+
+private:
+    nadi_status configure(nadi_message* message) {
+        if (is_segmented(*message)) return NADI_INVALID_MESSAGE;
+        auto text = payload_view(*message);
+        auto request = nlohmann::json::parse(text.begin(), text.end(), nullptr, false);
+        auto type = request.is_object() ? request.find("type") : request.end();
+        if (type == request.end() || *type != "shm.open") return NADI_INVALID_MESSAGE;
+        std::string error;
+        {
+            std::lock_guard lock{send_mutex_};
+            error = segment_ ? "already open" : open(request);
+        }
+        nlohmann::json response{{"type", "shm.open.confirm"}, {"status", error.empty() ? "success" : "error"}};
+        if (!error.empty()) response["error"] = error;
+        if (auto id = request.find("id"); id != request.end() && id->is_string()) response["id"] = *id;
+        message->free(message);
+        respond(response);
+        if (error.empty()) reader_ = std::thread{[this] { run(); }};
+        return NADI_OK;
+    }
+
+    // Requires send_mutex_. Returns an error text, empty on success.
+    std::string open(const nlohmann::json& request) {
+        auto name = request.find("name");
+        if (name == request.end() || !name->is_string() || name->get_ref<const std::string&>().size() < 2 ||
+            name->get_ref<const std::string&>()[0] != '/') {
+            return "name must be a string like \"/sensor1\"";
+        }
+        auto create_flag = request.find("create");
+        if (create_flag != request.end() && !create_flag->is_boolean()) return "create must be a boolean";
+        bool create = create_flag != request.end() && create_flag->get<bool>();
+        std::uint64_t slot_count = 256;
+        std::uint64_t slot_size = 65536;
+        if (!read_count(request, "slots", slot_count) || !read_count(request, "slot_size", slot_size) || slot_count < 1 ||
+            slot_count > 65536 || slot_size < 256 || slot_size > (std::uint64_t{1} << 30)) {
+            return "slots must be 1 to 65536 and slot_size 256 to 2^30";
+        }
+        slot_size = (slot_size + cache_line - 1) / cache_line * cache_line;
+
+        name_ = name->get<std::string>();
+        int fd = -1;
+        std::size_t size = 0;
+        if (create) {
+            shm_unlink(name_.c_str()); // leftover of a crashed creator
+            fd = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+            size = segment_size(static_cast<std::uint32_t>(slot_count), slot_size);
+            if (fd >= 0 && ftruncate(fd, static_cast<off_t>(size)) != 0) {
+                close(fd);
+                shm_unlink(name_.c_str());
+                return "cannot size the segment";
+            }
+        } else {
+            fd = shm_open(name_.c_str(), O_RDWR, 0);
+            struct stat info;
+            if (fd >= 0 && fstat(fd, &info) == 0) size = static_cast<std::size_t>(info.st_size);
+        }
+        if (fd < 0) return "cannot open the segment";
+        if (size < sizeof(segment_header)) {
+            close(fd);
+            return "not a nadi_shm segment";
+        }
+        void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED) return "cannot map the segment";
+        auto* segment = static_cast<segment_header*>(mapping);
+
+        if (create) {
+            // a new mapping is zero-filled, which is the initial state of every atomic
+            segment->version = layout_version;
+            segment->slot_count = static_cast<std::uint32_t>(slot_count);
+            segment->slot_size = slot_size;
+            segment->magic.store(magic, std::memory_order_release);
+        } else if (segment->magic.load(std::memory_order_acquire) != magic || segment->version != layout_version ||
+                   size != segment_size(segment->slot_count, segment->slot_size)) {
+            munmap(mapping, size);
+            return "not a nadi_shm segment, or not initialized yet";
+        } else if (segment->attached.exchange(1, std::memory_order_acq_rel) != 0) {
+            munmap(mapping, size);
+            return "the segment already has two endpoints";
+        }
+
+        segment_ = segment;
+        size_ = size;
+        endpoint_ = create ? 0 : 1;
+        out_ = ring_view{*segment, endpoint_};
+        in_ = ring_view{*segment, 1 - endpoint_};
+        deliveries_.resize(segment->slot_count);
+        return {};
+    }
+
+    static bool read_count(const nlohmann::json& request, const char* key, std::uint64_t& out) {
+        auto it = request.find(key);
+        if (it == request.end()) return true;
+        if (!it->is_number_unsigned()) return false;
+        out = it->get<std::uint64_t>();
+        return true;
+    }
+
+    void respond(const nlohmann::json& response) {
+        static const interned_meta json = meta_registry::instance().intern("json");
+        std::string text = response.dump();
+        nadi_message* message = message_pool::instance().allocate(json, text.size() + 1);
+        std::memcpy(message->data, text.c_str(), text.size() + 1);
+        message->channel = configuration_channel;
+        message->node = handle_;
+        receive_(message);
+    }
+
+    bool has_space() const noexcept { return out_.available() > 0; }
+
+    void run() {
+        std::uint64_t position = 0;
+        doorbell& bell = segment_->bells[endpoint_];
+        while (!stopping_.load(std::memory_order_acquire)) {
+            bool idle = true;
+            while (in_.ready(position)) {
+                deliver(position++);
+                idle = false;
+            }
+            if (blocked_channel_.load(std::memory_order_seq_cst) >= 0 && has_space()) {
+                std::int64_t channel = blocked_channel_.exchange(-1, std::memory_order_seq_cst);
+                if (channel >= 0) {
+                    auto credits = static_cast<std::int64_t>(out_.available());
+                    receive_(make_credit(handle_, static_cast<unsigned int>(channel), credits));
+                }
+                idle = false;
+            }
+            if (idle) {
+                wait(bell, [&] {
+                    return stopping_.load(std::memory_order_seq_cst) || in_.ready(position) ||
+                           (blocked_channel_.load(std::memory_order_seq_cst) >= 0 && has_space());
+                });
+            }
+        }
+    }
+
+    void deliver(std::uint64_t position) {
+        // the peer runs in another process, a corrupt slot must not take this one down, so the
+        // header is checked and used as one copy the peer cannot change in between
+        const slot_fields header = in_.slot(position).fields;
+        std::byte* slot = in_.bytes(position);
+        std::size_t meta_size = header.data_offset > sizeof(slot_header) ? header.data_offset - sizeof(slot_header) : 0;
+        if (meta_size == 0 || header.data_offset > in_.slot_size() || header.data_length > in_.slot_size() - header.data_offset ||
+            header.data_length >= NADI_EXTENDED || !std::memchr(slot + sizeof(slot_header), 0, meta_size)) {
+            if (in_.release(position)) ring(segment_->bells[1 - endpoint_]);
+            return;
+        }
+        delivery& d = deliveries_[position % deliveries_.size()];
+        d.message.meta = reinterpret_cast<const char*>(slot + sizeof(slot_header));
+        d.message.meta_hash = header.meta_hash;
+        d.message.data = slot + header.data_offset;
+        d.message.data_length = static_cast<unsigned int>(header.data_length);
+        d.message.channel = header.channel;
+        d.message.free = &bridge::release;
+        d.message.node = handle_;
+        d.owner = this;
+        d.position = position;
+        references_.fetch_add(1, std::memory_order_relaxed);
+        receive_(&d.message);
+    }
+
+    static void release(nadi_message* message) {
+        auto* d = reinterpret_cast<delivery*>(message);
+        bridge* self = d->owner;
+        if (self->in_.release(d->position)) ring(self->segment_->bells[1 - self->endpoint_]);
+        self->unref();
+    }
+
+    void unref() {
+        if (references_.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;
+    }
+
+    const nadi_node_handle handle_;
+    const nadi_receive_callback receive_;
+    std::mutex send_mutex_; // the outgoing ring has a single writer
+    std::string name_;
+    segment_header* segment_ = nullptr;
+    std::size_t size_ = 0;
+    int endpoint_ = 0;
+    ring_view out_;
+    ring_view in_;
+    std::vector<delivery> deliveries_;
+    std::atomic<std::int64_t> blocked_channel_{-1}; // channel of the last NADI_WOULD_BLOCK, -1 if none
+    std::atomic<bool> stopping_{false};
+    std::atomic<std::int64_t> references_{1};       // the node itself and every message not yet freed
+    std::thread reader_;
+};
+
+std::shared_mutex bridges_mutex;
+std::unordered_map<nadi_node_handle, bridge*> bridges;
+nadi_node_handle next_handle = 1;
+
+} // namespace
+
+} // namespace nadi::shm
+
+extern "C" {
+
+DLL_EXPORT nadi_status nadi_create(nadi_node_handle* node, nadi_receive_callback receive_callback) {
+    using namespace nadi::shm;
+    if (!node || !receive_callback) return NADI_INVALID_MESSAGE;
+    std::lock_guard lock{bridges_mutex};
+    *node = next_handle++;
+    bridges.emplace(*node, new bridge{*node, receive_callback});
+    return NADI_OK;
+}
+
+DLL_EXPORT nadi_status nadi_destroy(nadi_node_handle node) {
+    using namespace nadi::shm;
+    bridge* instance = nullptr;
+    {
+        std::lock_guard lock{bridges_mutex};
+        auto it = bridges.find(node);
+        if (it == bridges.end()) return NADI_INVALID_NODE;
+        instance = it->second;
+        bridges.erase(it);
+    }
+    instance->stop();
+    return NADI_OK;
+}
+
+DLL_EXPORT nadi_status nadi_send(nadi_message* message, nadi_node_handle node) {
+    using namespace nadi::shm;
+    if (!message) return NADI_INVALID_MESSAGE;
+    std::shared_lock lock{bridges_mutex};
+    auto it = bridges.find(node);
+    if (it == bridges.end()) return NADI_INVALID_NODE;
+    return it->second->send(message);
+}
+
+DLL_EXPORT void nadi_free(nadi_message* message) {
+    message->free(message);
+}
+
+DLL_EXPORT nadi_status nadi_descriptor(char* buffer, size_t* length) {
+    return nadi::shm::node_descriptor.write(buffer, length);
+}
+
+DLL_EXPORT nadi_status nadi_descriptor_view(const char** descriptor, size_t* length) {
+    return nadi::shm::node_descriptor.view(descriptor, length);
+}
+
+} // extern "C"
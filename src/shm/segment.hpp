@@ -0,0 +1,170 @@
+#pragma once
+
+#include <atomic>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace nadi::shm {
+
+// Layout of the POSIX shared-memory segment connecting two bridge endpoints. Endpoint 0 creates
+// the segment and endpoint 1 attaches to it. Each endpoint writes one ring and reads the other;
+// both sides map the same bytes, so everything shared is a lock-free atomic or written before it
+// is published through one.
+
+inline constexpr std::uint64_t magic = 0x4d48535f4944414eull; // "NADI_SHM"
+inline constexpr std::uint32_t layout_version = 1;
+inline constexpr std::size_t cache_line = 64;
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free && std::atomic<std::uint32_t>::is_always_lock_free,
+              "shared-memory atomics must be address-free");
+
+// Slot states are stored together with the ring position, so a stale position never matches a
+// reused slot.
+enum slot_state : std::uint64_t { empty = 0, full = 1, released = 2 };
+
+constexpr std::uint64_t state_of(std::uint64_t position, slot_state state) noexcept { return position * 4 + state; }
+
+// Message in a slot, written by the sender before it marks the slot full. The peer may still
+// write it afterwards, so the receiver copies it once and only uses the copy.
+struct slot_fields {
+    std::uint64_t meta_hash;
+    std::uint64_t data_length;
+    std::uint32_t channel;
+    std::uint32_t data_offset; // from the start of the slot
+};
+
+// Start of every slot, followed by the null-terminated meta and then the payload at data_offset.
+struct slot_header {
+    std::atomic<std::uint64_t> state;
+    slot_fields fields;
+};
+
+struct ring_header {
+    alignas(cache_line) std::atomic<std::uint64_t> head; // next position to write, writer only
+    alignas(cache_line) std::atomic<std::uint64_t> tail; // oldest position not yet released by the reader
+    alignas(cache_line) std::atomic<std::uint32_t> space_wanted; // the writer found the ring full
+};
+
+// Futex word an endpoint sleeps on, rung by its peer for new messages and for freed space.
+struct doorbell {
+    alignas(cache_line) std::atomic<std::uint32_t> sequence;
+    std::atomic<std::uint32_t> sleeping;
+};
+
+struct segment_header {
+    std::atomic<std::uint64_t> magic; // stored last by the creator
+    std::uint32_t version;
+    std::uint32_t slot_count;
+    std::uint64_t slot_size;
+    std::atomic<std::uint32_t> attached; // endpoint 1 is mapped
+    ring_header rings[2];                // rings[i] is written by endpoint i
+    doorbell bells[2];                   // bells[i] wakes endpoint i
+};
+
+constexpr std::size_t slots_offset() noexcept { return (sizeof(segment_header) + cache_line - 1) / cache_line * cache_line; }
+
+constexpr std::size_t segment_size(std::uint32_t slot_count, std::uint64_t slot_size) noexcept {
+    return slots_offset() + 2 * std::size_t{slot_count} * slot_size;
+}
+
+// Process-shared futex calls on a 32-bit atomic, so no FUTEX_PRIVATE_FLAG.
+inline void futex_wait(std::atomic<std::uint32_t>& word, std::uint32_t expected) noexcept {
+    syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAIT, expected, nullptr, nullptr, 0);
+}
+
+inline void futex_wake(std::atomic<std::uint32_t>& word) noexcept {
+    syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+inline void ring(doorbell& bell) noexcept {
+    bell.sequence.fetch_add(1, std::memory_order_seq_cst);
+    if (bell.sleeping.load(std::memory_order_seq_cst)) futex_wake(bell.sequence);
+}
+
+// Sleeps until the bell rings, unless ready() holds once the sleep is announced.
+template <class Ready>
+void wait(doorbell& bell, Ready&& ready) noexcept {
+    std::uint32_t sequence = bell.sequence.load(std::memory_order_seq_cst);
+    bell.sleeping.store(1, std::memory_order_seq_cst);
+    if (!ready()) futex_wait(bell.sequence, sequence);
+    bell.sleeping.store(0, std::memory_order_relaxed);
+}
+
+// One direction of a segment as seen from one endpoint.
+class ring_view {
+public:
+    ring_view() = default;
+    ring_view(segment_header& segment, int writer) noexcept
+        : header_{&segment.rings[writer]},
+          slots_{reinterpret_cast<std::byte*>(&segment) + slots_offset() + writer * std::size_t{segment.slot_count} * segment.slot_size},
+          slot_count_{segment.slot_count},
+          slot_size_{segment.slot_size} {}
+
+    slot_header& slot(std::uint64_t position) const noexcept {
+        return *reinterpret_cast<slot_header*>(slots_ + (position % slot_count_) * slot_size_);
+    }
+
+    std::byte* bytes(std::uint64_t position) const noexcept { return slots_ + (position % slot_count_) * slot_size_; }
+
+    std::uint64_t slot_size() const noexcept { return slot_size_; }
+
+    // Writer: position of a free slot, or false if the ring is full.
+    bool reserve(std::uint64_t& position) const noexcept {
+        position = header_->head.load(std::memory_order_relaxed);
+        return position - header_->tail.load(std::memory_order_seq_cst) < slot_count_;
+    }
+
+    // Number of free slots, exact on the writer and a lower bound elsewhere.
+    std::uint64_t available() const noexcept {
+        return slot_count_ - (header_->head.load(std::memory_order_relaxed) - header_->tail.load(std::memory_order_seq_cst));
+    }
+
+    // Writer: publishes the slot filled at position.
+    void commit(std::uint64_t position) const noexcept {
+        slot(position).state.store(state_of(position, full), std::memory_order_release);
+        header_->head.store(position + 1, std::memory_order_relaxed);
+    }
+
+    // Writer: asks the reader for a wakeup once it releases a slot. Returns false if space
+    // appeared meanwhile, so the caller retries instead of waiting.
+    bool want_space() const noexcept {
+        header_->space_wanted.store(1, std::memory_order_seq_cst);
+        std::uint64_t position;
+        return !reserve(position);
+    }
+
+    // Reader: whether the writer committed position.
+    bool ready(std::uint64_t position) const noexcept {
+        return slot(position).state.load(std::memory_order_acquire) == state_of(position, full);
+    }
+
+    // Reader, any thread: slots may be released in any order, the tail advances over every
+    // released slot at its front. Returns true if the writer asked to be told about the space.
+    bool release(std::uint64_t position) const noexcept {
+        slot(position).state.store(state_of(position, released), std::memory_order_seq_cst);
+        bool advanced = false;
+        for (;;) {
+            std::uint64_t tail = header_->tail.load(std::memory_order_seq_cst);
+            std::uint64_t expected = state_of(tail, released);
+            // the thread moving the slot to empty owns advancing the tail past it
+            if (!slot(tail).state.compare_exchange_strong(expected, state_of(tail, empty), std::memory_order_seq_cst)) break;
+            header_->tail.store(tail + 1, std::memory_order_seq_cst);
+            advanced = true;
+        }
+        return advanced && header_->space_wanted.load(std::memory_order_seq_cst) &&
+               header_->space_wanted.exchange(0, std::memory_order_seq_cst);
+    }
+
+private:
+    ring_header* header_ = nullptr;
+    std::byte* slots_ = nullptr;
+    std::uint32_t slot_count_ = 0;
+    std::uint64_t slot_size_ = 0;
+};
+
+} // namespace nadi::shm
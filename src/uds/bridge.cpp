@@ -0,0 +1,714 @@
+// nadi_uds: NADI node bridging a graph to a peer process over a Unix stream socket, for nodes that
+// cannot share memory with the host. Messages are framed as described in frame.hpp and written
+// with one sendmsg per batch; payloads above a threshold are copied once into sealed memfds passed
+// with SCM_RIGHTS, which the receiver maps instead of reading them through the socket.
+
+#include "frame.hpp"
+#ifdef NADI_UDS_IO_URING
+#include "uring.hpp"
+#endif
+
+#include <nadi/descriptor_builder.hpp>
+#include <nadi/message_pool.hpp>
+#include <nadi/meta_registry.hpp>
+#include <nadi/nadi.h>
+#include <nadi/segmented_message.hpp>
+#include <nadi/send_batch.hpp>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace nadi::uds {
+
+namespace {
+
+constexpr unsigned int configuration_channel = 0xF100;
+constexpr std::size_t receive_buffer_size = 256 * 1024;
+
+const descriptor node_descriptor =
+    descriptor_builder{"1.0.0"}
+        .description("Bridges to a peer process over a Unix domain socket. Messages sent to any input channel other than "
+                     "0xF100 leave the peer's bridge on the output channel with the same number.")
+        .input(configuration_channel, "configuration", {"json"}, "uds.open connects the bridge to its peer")
+        .output(configuration_channel, "configuration", {"json"}, "uds.open.confirm and uds.closed")
+        .feature("send batch")
+        .feature("receive batch")
+        .feature("segmented messages")
+        .feature("extended messages")
+        .build();
+
+// Message received as a memfd, data is a private mapping of it.
+struct mapped_message {
+    nadi_message message;
+    nadi_extended_payload mapping; // also the payload of extended messages
+    std::string meta;
+
+    static void free(nadi_message* message) {
+        auto* self = reinterpret_cast<mapped_message*>(message);
+        if (self->mapping.length > 0) munmap(self->mapping.data, self->mapping.length);
+        delete self;
+    }
+};
+
+class bridge {
+public:
+    bridge(nadi_node_handle handle, nadi_receive_callback receive, nadi_receive_batch_callback receive_batch) noexcept
+        : handle_{handle}, receive_{receive}, receive_batch_{receive_batch} {}
+
+    // Returns the number of messages looked at, which ends after one refused with NADI_WOULD_BLOCK.
+    std::size_t send(nadi_message** messages, std::size_t count, nadi_status* statuses) {
+        std::size_t begin = 0;
+        while (begin < count) {
+            std::size_t end = begin;
+            if (messages[begin]->channel == configuration_channel) {
+                statuses[end++] = configure(messages[begin]);
+            } else {
+                while (end < count && end - begin < max_messages_per_call && messages[end]->channel != configuration_channel) ++end;
+                end = begin + write(messages + begin, end - begin, statuses + begin);
+            }
+            for (; begin < end; ++begin) {
+                if (statuses[begin] == NADI_WOULD_BLOCK) return begin + 1;
+            }
+        }
+        return count;
+    }
+
+    // Closes the connection, waits for the reader thread and deletes the bridge.
+    void stop() {
+        {
+            std::lock_guard lock{send_mutex_};
+            stopping_ = true;
+            if (listener_ >= 0) shutdown(listener_, SHUT_RDWR);
+            if (socket_ >= 0) shutdown(socket_, SHUT_RDWR);
+        }
+        if (reader_.joinable()) reader_.join();
+        {
+            std::lock_guard lock{send_mutex_};
+            disconnect();
+        }
+        delete this;
+    }
+
+private:
+    nadi_status configure(nadi_message* message) {
+        if (is_segmented(*message)) return NADI_INVALID_MESSAGE;
+        auto text = payload_view(*message);
+        auto request = nlohmann::json::parse(text.begin(), text.end(), nullptr, false);
+        auto type = request.is_object() ? request.find("type") : request.end();
+        if (type == request.end() || *type != "uds.open") return NADI_INVALID_MESSAGE;
+        std::string id;
+        if (auto it = request.find("id"); it != request.end() && it->is_string()) id = it->get<std::string>();
+        std::string error;
+        bool listening = false;
+        std::thread previous;
+        {
+            std::lock_guard lock{send_mutex_};
+            if (socket_ < 0 && listener_ < 0) previous = std::move(reader_);
+        }
+        retire(previous);
+        {
+            std::lock_guard lock{send_mutex_};
+            error = socket_ >= 0 || listener_ >= 0 ? "already open" : open(request);
+            listening = error.empty() && listener_ >= 0;
+            if (listening) open_id_ = id;
+        }
+        message->free(message);
+        // a listening bridge confirms once its peer has connected
+        if (!listening) respond("uds.open.confirm", id, error);
+        if (error.empty()) {
+            // the connection may have been lost and reopened since the first section, leaving
+            // its reader in reader_
+            {
+                std::lock_guard lock{send_mutex_};
+                previous = std::move(reader_);
+                reader_ = std::thread{[this] { run(); }};
+            }
+            retire(previous);
+        }
+        return NADI_OK;
+    }
+
+    // Waits for the reader of a lost connection, which has finished or is about to after sending
+    // uds.closed. That may have called configure on the reader itself, which is detached instead.
+    static void retire(std::thread& reader) {
+        if (reader.joinable() && reader.get_id() == std::this_thread::get_id()) {
+            reader.detach();
+        } else if (reader.joinable()) {
+            reader.join();
+        }
+    }
+
+    // Requires send_mutex_. Returns an error text, empty on success.
+    std::string open(const nlohmann::json& request) {
+        auto path = request.find("path");
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (path == request.end() || !path->is_string() || path->get_ref<const std::string&>().empty() ||
+            path->get_ref<const std::string&>().size() >= sizeof(address.sun_path)) {
+            return "path must be a socket path of at most " + std::to_string(sizeof(address.sun_path) - 1) + " bytes";
+        }
+        auto listen_flag = request.find("listen");
+        if (listen_flag != request.end() && !listen_flag->is_boolean()) return "listen must be a boolean";
+        auto threshold = request.find("memfd_threshold");
+        if (threshold != request.end() && (!threshold->is_number_unsigned() || threshold->get<std::uint64_t>() >= NADI_EXTENDED)) {
+            return "memfd_threshold must be a positive integer below 4 GiB"; // larger payloads cannot be framed inline
+        }
+        if (threshold != request.end()) memfd_threshold_ = std::max<std::uint64_t>(1, threshold->get<std::uint64_t>());
+        auto uring_flag = request.find("io_uring");
+        if (uring_flag != request.end() && !uring_flag->is_boolean()) return "io_uring must be a boolean";
+        use_uring_ = uring_flag != request.end() && uring_flag->get<bool>();
+
+        path_ = path->get<std::string>();
+        std::memcpy(address.sun_path, path_.c_str(), path_.size() + 1);
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) return "cannot create a socket";
+        if (listen_flag != request.end() && listen_flag->get<bool>()) {
+            unlink(path_.c_str()); // leftover of a crashed listener
+            if (bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(fd, 1) != 0) {
+                close(fd);
+                return "cannot listen on " + path_;
+            }
+            listener_ = fd;
+        } else {
+            if (connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+                close(fd);
+                return "cannot connect to " + path_;
+            }
+            socket_ = fd;
+        }
+        broken_ = false;
+        return {};
+    }
+
+    // Requires send_mutex_. Closes the connection, after which uds.open may open a new one.
+    void disconnect() {
+        if (socket_ >= 0) close(socket_);
+        if (listener_ >= 0) {
+            close(listener_);
+            unlink(path_.c_str());
+        }
+        socket_ = -1;
+        listener_ = -1;
+    }
+
+    void respond(std::string_view type, const std::string& id, const std::string& error) {
+        static const interned_meta json = meta_registry::instance().intern("json");
+        nlohmann::json response{{"type", type}, {"status", error.empty() ? "success" : "error"}};
+        if (!error.empty()) response["error"] = error;
+        if (!id.empty()) response["id"] = id;
+        std::string text = response.dump();
+        nadi_message* message = message_pool::instance().allocate(json, text.size() + 1);
+        std::memcpy(message->data, text.c_str(), text.size() + 1);
+        message->channel = configuration_channel;
+        message->node = handle_;
+        receive_(message);
+    }
+
+    // Sends a prefix of messages in one sendmsg and returns its length. Messages are freed once
+    // written; on a broken connection they stay with the caller. Payloads of NADI_EXTENDED bytes or
+    // more that cannot go into a memfd are refused with NADI_INVALID_MESSAGE, as the peer would
+    // take their inline frame for a protocol violation and drop the connection.
+    std::size_t write(nadi_message** messages, std::size_t count, nadi_status* statuses) {
+        frame_header headers[max_messages_per_call];
+        int fds[max_fds_per_call];
+        std::size_t fd_count = 0;
+        std::size_t n = 0;
+        std::unique_lock lock{send_mutex_};
+        if (socket_ < 0 || broken_) {
+            std::fill_n(statuses, count, NADI_NOT_INITIALIZED);
+            return count;
+        }
+        iovecs_.clear();
+        for (; n < count; ++n) {
+            nadi_message* message = messages[n];
+            const char* meta = message->meta ? message->meta : "";
+            std::size_t meta_size = std::strlen(meta) + 1;
+            std::uint64_t length = payload_length(*message);
+            int fd = -1;
+            if (length >= memfd_threshold_) {
+                if (fd_count == max_fds_per_call) break;
+                fd = make_memfd(*message); // falls back to the socket on failure
+            }
+            if (fd < 0 && length >= NADI_EXTENDED) {
+                statuses[n] = NADI_INVALID_MESSAGE;
+                continue;
+            }
+            statuses[n] = NADI_OK;
+            headers[n] = {frame_magic, fd >= 0 ? frame_memfd : 0u, message->node,
+                          message->meta_hash ? message->meta_hash : nadi_meta_hash(meta), length,
+                          message->channel, static_cast<std::uint32_t>(meta_size)};
+            iovecs_.push_back({&headers[n], sizeof(frame_header)});
+            iovecs_.push_back({const_cast<char*>(meta), meta_size});
+            if (fd >= 0) {
+                fds[fd_count++] = fd;
+            } else if (is_segmented(*message)) {
+                for (const auto& segment : segments_of(*message)) {
+                    if (segment.length > 0) iovecs_.push_back({segment.data, segment.length});
+                }
+            } else if (length > 0) {
+                iovecs_.push_back({const_cast<char*>(payload_view(*message).data()), static_cast<std::size_t>(length)});
+            }
+        }
+        bool sent = send_all(iovecs_.data(), iovecs_.size(), fds, fd_count);
+        lock.unlock();
+        for (std::size_t i = 0; i < fd_count; ++i) close(fds[i]);
+        for (std::size_t i = 0; i < n; ++i) {
+            if (statuses[i] != NADI_OK) continue;
+            statuses[i] = sent ? NADI_OK : NADI_NOT_INITIALIZED;
+            if (sent) messages[i]->free(messages[i]);
+        }
+        return n;
+    }
+
+    // Requires send_mutex_. Writes everything, passing the fds with the first bytes.
+    bool send_all(iovec* iov, std::size_t iov_count, const int* fds, std::size_t fd_count) {
+        msghdr header{};
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * max_fds_per_call)];
+        if (fd_count > 0) {
+            header.msg_control = control;
+            header.msg_controllen = CMSG_SPACE(sizeof(int) * fd_count);
+            cmsghdr* rights = CMSG_FIRSTHDR(&header);
+            rights->cmsg_level = SOL_SOCKET;
+            rights->cmsg_type = SCM_RIGHTS;
+            rights->cmsg_len = CMSG_LEN(sizeof(int) * fd_count);
+            std::memcpy(CMSG_DATA(rights), fds, sizeof(int) * fd_count);
+        }
+        while (iov_count > 0) {
+            // many segments may exceed what one call takes
+            header.msg_iov = iov;
+            header.msg_iovlen = std::min<std::size_t>(iov_count, IOV_MAX);
+            ssize_t written = sendmsg(socket_, &header, MSG_NOSIGNAL);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                // a partial frame may be on the wire, nothing can follow it; the reader then sees
+                // the end of the connection and closes it
+                broken_ = true;
+                shutdown(socket_, SHUT_RDWR);
+                return false;
+            }
+            header.msg_control = nullptr;
+            header.msg_controllen = 0;
+            auto remaining = static_cast<std::size_t>(written);
+            while (iov_count > 0 && remaining >= iov->iov_len) {
+                remaining -= iov->iov_len;
+                ++iov;
+                --iov_count;
+            }
+            if (iov_count > 0) {
+                iov->iov_base = static_cast<char*>(iov->iov_base) + remaining;
+                iov->iov_len -= remaining;
+            }
+        }
+        return true;
+    }
+
+    // Sealed copy of the payload, so the receiver can map it without fearing a truncation. This is
+    // the one copy a large payload costs: it skips the socket buffer and the receiver's read.
+    static int make_memfd(const nadi_message& message) {
+        int fd = memfd_create("nadi_uds", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        if (fd < 0) return -1;
+        auto write_all = [fd](const void* data, std::size_t length) {
+            const char* bytes = static_cast<const char*>(data);
+            while (length > 0) {
+                ssize_t written = ::write(fd, bytes, length);
+                if (written < 0 && errno == EINTR) continue;
+                if (written <= 0) return false;
+                bytes += written;
+                length -= static_cast<std::size_t>(written);
+            }
+            return true;
+        };
+        bool written = true;
+        if (is_segmented(message)) {
+            for (const auto& segment : segments_of(message)) written = written && write_all(segment.data, segment.length);
+        } else {
+            auto payload = payload_view(message);
+            written = write_all(payload.data(), payload.size());
+        }
+        if (!written || fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) != 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    void run() {
+        if (listener_ >= 0) {
+            int fd = accept4(listener_, nullptr, nullptr, SOCK_CLOEXEC);
+            bool stopping;
+            {
+                std::lock_guard lock{send_mutex_};
+                stopping = stopping_;
+                if (stopping && fd >= 0) {
+                    close(fd);
+                    fd = -1;
+                }
+                if (fd < 0) disconnect();
+                socket_ = fd;
+            }
+            if (fd < 0) {
+                if (!stopping) respond("uds.open.confirm", open_id_, "cannot accept a connection on " + path_);
+                return;
+            }
+            respond("uds.open.confirm", open_id_, {});
+        }
+        receive();
+        bool stopping;
+        {
+            std::lock_guard lock{send_mutex_};
+            disconnect();
+            stopping = stopping_;
+        }
+        if (!stopping) respond("uds.closed", {}, {});
+    }
+
+    // Frame assembly of the reader thread.
+    struct input {
+        std::vector<char> buffer = std::vector<char>(receive_buffer_size);
+        std::size_t begin = 0;
+        std::size_t end = 0;
+        std::deque<int> fds; // received with SCM_RIGHTS, not yet claimed by a frame
+        std::vector<nadi_message*> batch;
+
+        ~input() {
+            for (int fd : fds) close(fd);
+        }
+
+        // Free space after the buffered bytes, at least minimum bytes of it.
+        std::size_t reserve(std::size_t minimum) {
+            if (begin > 0) {
+                std::memmove(buffer.data(), buffer.data() + begin, end - begin);
+                end -= begin;
+                begin = 0;
+            }
+            if (buffer.size() - end < minimum) buffer.resize(std::max(buffer.size() * 2, end + minimum));
+            return buffer.size() - end;
+        }
+    };
+
+    void receive() {
+        input in;
+#ifdef NADI_UDS_IO_URING
+        if (use_uring_ && receive_uring(in)) return;
+#endif
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * max_fds_per_call)];
+        for (;;) {
+            in.reserve(1);
+            iovec iov{in.buffer.data() + in.end, in.buffer.size() - in.end};
+            msghdr header{};
+            header.msg_iov = &iov;
+            header.msg_iovlen = 1;
+            header.msg_control = control;
+            header.msg_controllen = sizeof(control);
+            ssize_t received = recvmsg(socket_, &header, MSG_CMSG_CLOEXEC);
+            if (received < 0 && errno == EINTR) continue;
+            take_rights(header, in.fds);
+            if (received <= 0 || (header.msg_flags & MSG_CTRUNC)) return;
+            in.end += static_cast<std::size_t>(received);
+            if (!parse(in)) return;
+        }
+    }
+
+#ifdef NADI_UDS_IO_URING
+    // Receives with one multishot recvmsg drawing on a ring of provided buffers, so reads need no
+    // submissions and every wakeup reaps all reads completed meanwhile. Frames are parsed out of
+    // the provided buffers, which skips the copy into in.buffer that plain recvmsg needs, and
+    // io_uring_enter is only called to wait when no completion is queued. Returns false, before
+    // anything was read, if the kernel lacks a feature, to fall back to plain recvmsg.
+    bool receive_uring(input& in) {
+        constexpr std::uint64_t receive_request = 1;
+        constexpr std::uint16_t buffer_group = 0;
+        buffer_ring buffers; // destroyed after the ring below
+        uring ring;
+        msghdr request{};
+        request.msg_controllen = CMSG_SPACE(sizeof(int) * max_fds_per_call);
+        if (!ring.open(8) || !buffers.open(ring, buffer_group, 64, 64 * 1024)) return false;
+        bool armed = false;
+        bool received_any = false;
+        bool unsupported = false;
+        bool done = false;
+        while (!done) {
+            if (!armed) {
+                io_uring_sqe* sqe = ring.prepare();
+                sqe->opcode = IORING_OP_RECVMSG;
+                sqe->fd = socket_;
+                sqe->addr = reinterpret_cast<std::uint64_t>(&request);
+                sqe->len = 1;
+                sqe->msg_flags = MSG_CMSG_CLOEXEC;
+                sqe->flags = IOSQE_BUFFER_SELECT;
+                sqe->buf_group = buffer_group;
+                sqe->ioprio = IORING_RECV_MULTISHOT;
+                sqe->user_data = receive_request;
+                armed = true;
+            }
+            if (ring.enter(1) != 0) return received_any;
+            ring.complete([&](const io_uring_cqe& completion) {
+                if (done) return;
+                if (!(completion.flags & IORING_CQE_F_MORE)) armed = false;
+                if (completion.res < 0) {
+                    // out of buffers ends the multishot, it is rearmed once some came back
+                    if (completion.res == -ENOBUFS) return;
+                    if (!received_any && (completion.res == -EINVAL || completion.res == -EOPNOTSUPP)) {
+                        unsupported = true;
+                    }
+                    done = true;
+                    return;
+                }
+                received_any = true;
+                if (!(completion.flags & IORING_CQE_F_BUFFER)) {
+                    done = true;
+                    return;
+                }
+                auto id = static_cast<std::uint16_t>(completion.flags >> IORING_CQE_BUFFER_SHIFT);
+                auto* out = reinterpret_cast<io_uring_recvmsg_out*>(buffers.buffer(id));
+                char* control = reinterpret_cast<char*>(out + 1) + request.msg_namelen;
+                char* payload = control + request.msg_controllen;
+                msghdr header{};
+                header.msg_control = control;
+                header.msg_controllen = out->controllen;
+                take_rights(header, in.fds);
+                std::size_t filled = static_cast<std::size_t>(completion.res);
+                std::size_t offset = static_cast<std::size_t>(payload - reinterpret_cast<char*>(out));
+                std::size_t size = std::min<std::size_t>(out->payloadlen, filled > offset ? filled - offset : 0);
+                if (size == 0 || (out->flags & MSG_CTRUNC) || !parse_received(in, payload, size)) done = true;
+                buffers.give_back(id);
+            });
+            // one batch for all reads reaped by this wakeup
+            emit(in.batch);
+            in.batch.clear();
+        }
+        return !unsupported;
+    }
+
+    // Parses the frames of one provided buffer in place, so it can go back to the ring right after.
+    // Only frames spanning buffers pass through in.buffer: the one begun in earlier buffers is
+    // completed there, and the incomplete one at the end is kept there. Returns false on a
+    // protocol violation.
+    bool parse_received(input& in, const char* data, std::size_t size) {
+        while (in.end > in.begin && size > 0) {
+            // first the rest of the header, to learn the frame's size, then the rest of the frame
+            std::size_t buffered = in.end - in.begin;
+            std::size_t wanted = sizeof(frame_header);
+            if (buffered >= sizeof(frame_header)) {
+                frame_header frame;
+                std::memcpy(&frame, in.buffer.data() + in.begin, sizeof(frame));
+                if ((wanted = frame_size(frame)) == 0) return false;
+            }
+            std::size_t taken = std::min(wanted - buffered, size);
+            in.reserve(taken);
+            std::memcpy(in.buffer.data() + in.end, data, taken);
+            in.end += taken;
+            data += taken;
+            size -= taken;
+            std::size_t used = 0;
+            if (!parse_frames(in.buffer.data() + in.begin, in.end - in.begin, in, used)) return false;
+            in.begin += used;
+        }
+        if (in.end > in.begin) return true;
+        in.begin = in.end = 0;
+        std::size_t used = 0;
+        if (!parse_frames(data, size, in, used)) return false;
+        in.reserve(size - used);
+        std::memcpy(in.buffer.data() + in.end, data + used, size - used);
+        in.end += size - used;
+        return true;
+    }
+#endif
+
+    static void take_rights(msghdr& header, std::deque<int>& fds) {
+        for (cmsghdr* c = CMSG_FIRSTHDR(&header); c; c = CMSG_NXTHDR(&header, c)) {
+            if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS) continue;
+            std::size_t n = (c->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            for (std::size_t i = 0; i < n; ++i) {
+                int fd;
+                std::memcpy(&fd, CMSG_DATA(c) + i * sizeof(int), sizeof(int));
+                fds.push_back(fd);
+            }
+        }
+    }
+
+    // Emits the complete frames buffered in in. Returns false on a protocol violation.
+    bool parse(input& in) {
+        std::size_t used = 0;
+        bool valid = parse_frames(in.buffer.data() + in.begin, in.end - in.begin, in, used);
+        in.begin += used;
+        emit(in.batch);
+        in.batch.clear();
+        return valid;
+    }
+
+    // Adds the complete frames at the start of data to in.batch and sets used to their size.
+    // Returns false on a protocol violation.
+    bool parse_frames(const char* data, std::size_t size, input& in, std::size_t& used) {
+        used = 0;
+        for (;;) {
+            frame_header frame;
+            std::size_t length;
+            frame_status status = read_frame(data + used, size - used, frame, length);
+            if (status == frame_status::invalid) return false;
+            if (status == frame_status::incomplete) break;
+            const char* meta = data + used + sizeof(frame_header);
+            used += length;
+            nadi_message* message = (frame.flags & frame_memfd) ? map(frame, meta, in.fds) : copy(frame, meta, meta + frame.meta_length);
+            if (!message) return false;
+            in.batch.push_back(message);
+        }
+        return true;
+    }
+
+    nadi_message* copy(const frame_header& frame, const char* meta, const char* data) {
+        nadi_message* message = message_pool::instance().allocate(std::string_view{meta, frame.meta_length - 1}, frame.data_length);
+        if (frame.data_length > 0) std::memcpy(message->data, data, frame.data_length);
+        message->channel = frame.channel;
+        message->node = handle_;
+        return message;
+    }
+
+    nadi_message* map(const frame_header& frame, const char* meta, std::deque<int>& fds) {
+        if (fds.empty()) return nullptr;
+        int fd = fds.front();
+        fds.pop_front();
+        // Only a memfd the peer can neither truncate nor write any more is mapped, so the payload
+        // cannot change or vanish under the receiver of the private mapping.
+        constexpr int required_seals = F_SEAL_SHRINK | F_SEAL_WRITE;
+        struct stat info;
+        int seals = fcntl(fd, F_GET_SEALS);
+        void* data = nullptr;
+        if (seals >= 0 && (seals & required_seals) == required_seals && fstat(fd, &info) == 0 &&
+            static_cast<std::uint64_t>(info.st_size) >= frame.data_length) {
+            data = frame.data_length > 0 ? mmap(nullptr, frame.data_length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0) : nullptr;
+        }
+        close(fd);
+        if (data == MAP_FAILED || (frame.data_length > 0 && !data)) return nullptr;
+        auto* message = new mapped_message{{}, {data, frame.data_length}, std::string{meta, frame.meta_length - 1}};
+        bool extended = frame.data_length >= NADI_EXTENDED; // a large capture stays one mapping
+        message->message.meta = message->meta.c_str();
+        message->message.meta_hash = frame.meta_hash;
+        message->message.data = extended ? static_cast<void*>(&message->mapping) : data;
+        message->message.data_length = extended ? NADI_EXTENDED : static_cast<unsigned int>(frame.data_length);
+        message->message.channel = frame.channel;
+        message->message.free = &mapped_message::free;
+        message->message.node = handle_;
+        return &message->message;
+    }
+
+    void emit(std::vector<nadi_message*>& batch) {
+        if (batch.size() > 1 && receive_batch_) {
+            receive_batch_(batch.data(), batch.size());
+        } else {
+            for (nadi_message* message : batch) receive_(message);
+        }
+    }
+
+    const nadi_node_handle handle_;
+    const nadi_receive_callback receive_;
+    const nadi_receive_batch_callback receive_batch_;
+    std::mutex send_mutex_; // frames of concurrent senders must not interleave
+    std::vector<iovec> iovecs_; // requires send_mutex_
+    std::string path_;
+    std::string open_id_; // of a listening bridge, confirmed once the peer connects
+    std::uint64_t memfd_threshold_ = default_memfd_threshold;
+    bool use_uring_ = false; // receive through io_uring where the build and the kernel have it
+    int listener_ = -1;
+    int socket_ = -1;
+    bool broken_ = false;
+    bool stopping_ = false;
+    std::thread reader_;
+};
+
+std::shared_mutex bridges_mutex;
+std::unordered_map<nadi_node_handle, bridge*> bridges;
+nadi_node_handle next_handle = 1;
+
+nadi_status create(nadi_node_handle* node, nadi_receive_callback receive, nadi_receive_batch_callback receive_batch) {
+    if (!node || !receive) return NADI_INVALID_MESSAGE;
+    std::lock_guard lock{bridges_mutex};
+    *node = next_handle++;
+    bridges.emplace(*node, new bridge{*node, receive, receive_batch});
+    return NADI_OK;
+}
+
+} // namespace
+
+} // namespace nadi::uds
+
+extern "C" {
+
+DLL_EXPORT nadi_status nadi_create(nadi_node_handle* node, nadi_receive_callback receive_callback) {
+    return nadi::uds::create(node, receive_callback, nullptr);
+}
+
+DLL_EXPORT nadi_status nadi_create_ex(nadi_node_handle* node, nadi_receive_callback receive_callback,
+                                      nadi_receive_batch_callback receive_batch_callback) {
+    return nadi::uds::create(node, receive_callback, receive_batch_callback);
+}
+
+DLL_EXPORT nadi_status nadi_destroy(nadi_node_handle node) {
+    using namespace nadi::uds;
+    bridge* instance = nullptr;
+    {
+        std::lock_guard lock{bridges_mutex};
+        auto it = bridges.find(node);
+        if (it == bridges.end()) return NADI_INVALID_NODE;
+        instance = it->second;
+        bridges.erase(it);
+    }
+    instance->stop();
+    return NADI_OK;
+}
+
+DLL_EXPORT nadi_status nadi_send(nadi_message* message, nadi_node_handle node) {
+    using namespace nadi::uds;
+    if (!message) return NADI_INVALID_MESSAGE;
+    std::shared_lock lock{bridges_mutex};
+    auto it = bridges.find(node);
+    if (it == bridges.end()) return NADI_INVALID_NODE;
+    nadi_status status;
+    it->second->send(&message, 1, &status);
+    return status;
+}
+
+DLL_EXPORT nadi_status nadi_send_batch(nadi_message** messages, size_t count, nadi_node_handle node, nadi_status* statuses,
+                                       size_t* accepted) {
+    using namespace nadi::uds;
+    if (!accepted) return NADI_INVALID_MESSAGE;
+    *accepted = 0;
+    if (!messages || !statuses) return NADI_INVALID_MESSAGE;
+    std::shared_lock lock{bridges_mutex};
+    auto it = bridges.find(node);
+    if (it == bridges.end()) return NADI_INVALID_NODE;
+    return nadi::batch_status(statuses, it->second->send(messages, count, statuses), accepted);
+}
+
+DLL_EXPORT void nadi_free(nadi_message* message) {
+    message->free(message);
+}
+
+DLL_EXPORT nadi_status nadi_descriptor(char* buffer, size_t* length) {
+    return nadi::uds::node_descriptor.write(buffer, length);
+}
+
+DLL_EXPORT nadi_status nadi_descriptor_view(const char** descriptor, size_t* length) {
+    return nadi::uds::node_descriptor.view(descriptor, length);
+}
+
+} // extern "C"
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <nadi/nadi.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace nadi::uds {
+
+// Wire format of nadi_uds: a stream of frames, each a frame_header followed by meta_length bytes
+// of null-terminated meta and, unless the payload travels in a memfd, data_length bytes of data.
+// Both ends run on the same host, so fields are in native byte order.
+
+inline constexpr std::uint32_t frame_magic = 0x4e414449; // "NADI"
+
+enum frame_flags : std::uint32_t {
+    // The payload is the content of a sealed memfd passed with SCM_RIGHTS. Descriptors are
+    // consumed in order, one per frame with this flag.
+    frame_memfd = 1,
+};
+
+struct frame_header {
+    std::uint32_t magic;
+    std::uint32_t flags;
+    std::uint64_t node; // sender's handle, informational: the receiving bridge emits with its own
+    std::uint64_t meta_hash;
+    std::uint64_t data_length;
+    std::uint32_t channel;
+    std::uint32_t meta_length; // including the null terminator
+};
+
+static_assert(sizeof(frame_header) == 40);
+
+// Size of the frame starting with header, 0 if the header is not valid. Payloads of NADI_EXTENDED
+// bytes and more only travel in a memfd.
+inline std::size_t frame_size(const frame_header& header) noexcept {
+    bool in_memfd = header.flags & frame_memfd;
+    if (header.magic != frame_magic || header.meta_length == 0 || (!in_memfd && header.data_length >= NADI_EXTENDED)) return 0;
+    return sizeof(frame_header) + header.meta_length + (in_memfd ? 0 : header.data_length);
+}
+
+enum class frame_status { complete, incomplete, invalid };
+
+// Checks the frame at the start of the size bytes at data. Once they hold all of it, sets header
+// and its length and returns complete, or invalid if its meta is not null-terminated.
+inline frame_status read_frame(const char* data, std::size_t size, frame_header& header, std::size_t& length) noexcept {
+    if (size < sizeof(frame_header)) return frame_status::incomplete;
+    std::memcpy(&header, data, sizeof(header));
+    if ((length = frame_size(header)) == 0) return frame_status::invalid;
+    if (size < length) return frame_status::incomplete;
+    return data[sizeof(frame_header) + header.meta_length - 1] == '\0' ? frame_status::complete : frame_status::invalid;
+}
+
+// Payloads from this size on go through a memfd by default instead of the socket.
+inline constexpr std::size_t default_memfd_threshold = 64 * 1024;
+
+// Limits of one sendmsg call: three iovecs per message and the fds of one SCM_RIGHTS message.
+inline constexpr std::size_t max_messages_per_call = 256;
+inline constexpr std::size_t max_fds_per_call = 253;
+
+} // namespace nadi::uds
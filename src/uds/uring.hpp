@@ -0,0 +1,183 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace nadi::uds {
+
+// Minimal io_uring on the raw system calls, with only what the bridge's reader uses: one
+// submission and one completion queue and a ring of provided buffers. A ring has a single user
+// thread.
+class uring {
+public:
+    uring() = default;
+    uring(const uring&) = delete;
+    uring& operator=(const uring&) = delete;
+    ~uring() { close(); }
+
+    // False if the kernel has no io_uring or refuses it, e.g. by sysctl or seccomp.
+    bool open(unsigned entries) noexcept {
+        io_uring_params params{};
+        params.flags = IORING_SETUP_CLAMP;
+        int fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd < 0) return false;
+        fd_ = fd;
+        if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+            close();
+            return false;
+        }
+        ring_size_ = std::max<std::size_t>(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                                           params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+        sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+        void* ring = mmap(nullptr, ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (ring == MAP_FAILED || sqes == MAP_FAILED) {
+            if (ring != MAP_FAILED) munmap(ring, ring_size_);
+            if (sqes != MAP_FAILED) munmap(sqes, sqes_size_);
+            ::close(fd_);
+            fd_ = -1;
+            return false;
+        }
+        ring_ = static_cast<std::byte*>(ring);
+        sqes_ = static_cast<io_uring_sqe*>(sqes);
+        sq_head_ = reinterpret_cast<unsigned*>(ring_ + params.sq_off.head);
+        sq_tail_ = reinterpret_cast<unsigned*>(ring_ + params.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<unsigned*>(ring_ + params.sq_off.ring_mask);
+        sq_entries_ = params.sq_entries;
+        cq_head_ = reinterpret_cast<unsigned*>(ring_ + params.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned*>(ring_ + params.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned*>(ring_ + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(ring_ + params.cq_off.cqes);
+        auto* array = reinterpret_cast<unsigned*>(ring_ + params.sq_off.array);
+        for (unsigned i = 0; i < sq_entries_; ++i) array[i] = i;
+        return true;
+    }
+
+    void close() noexcept {
+        if (fd_ < 0) return;
+        munmap(sqes_, sqes_size_);
+        munmap(ring_, ring_size_);
+        ::close(fd_);
+        fd_ = -1;
+    }
+
+    int fd() const noexcept { return fd_; }
+
+    // A cleared submission entry, or nullptr if the queue is full. It is submitted by enter(),
+    // the kernel does not look at the tail before, so it is published right away.
+    io_uring_sqe* prepare() noexcept {
+        unsigned tail = *sq_tail_;
+        if (tail - std::atomic_ref{*sq_head_}.load(std::memory_order_acquire) == sq_entries_) return nullptr;
+        io_uring_sqe* sqe = &sqes_[tail & sq_mask_];
+        std::memset(sqe, 0, sizeof(*sqe));
+        std::atomic_ref{*sq_tail_}.store(tail + 1, std::memory_order_release);
+        return sqe;
+    }
+
+    // Submits the prepared entries and waits until at least wait_for completions are queued.
+    // Returns 0 or a negative errno.
+    int enter(unsigned wait_for) noexcept {
+        for (;;) {
+            // the kernel's head shows what it consumed, so an interrupted call can simply repeat
+            unsigned pending = *sq_tail_ - std::atomic_ref{*sq_head_}.load(std::memory_order_acquire);
+            if (pending == 0 && (wait_for == 0 || ready() >= wait_for)) return 0;
+            long result = syscall(__NR_io_uring_enter, fd_, pending, wait_for, wait_for ? IORING_ENTER_GETEVENTS : 0u, nullptr, 0);
+            if (result >= 0 && (wait_for == 0 || ready() >= wait_for)) return 0;
+            if (result < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) return -errno;
+        }
+    }
+
+    unsigned ready() const noexcept {
+        return std::atomic_ref{*cq_tail_}.load(std::memory_order_acquire) - *cq_head_;
+    }
+
+    // Calls handle for every queued completion and returns their number.
+    template <class Handle>
+    unsigned complete(Handle&& handle) {
+        unsigned head = *cq_head_;
+        unsigned tail = std::atomic_ref{*cq_tail_}.load(std::memory_order_acquire);
+        for (unsigned i = head; i != tail; ++i) {
+            handle(cqes_[i & cq_mask_]);
+        }
+        std::atomic_ref{*cq_head_}.store(tail, std::memory_order_release);
+        return tail - head;
+    }
+
+private:
+    int fd_ = -1;
+    std::byte* ring_ = nullptr;
+    std::size_t ring_size_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    std::size_t sqes_size_ = 0;
+    unsigned* sq_head_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned sq_entries_ = 0;
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+};
+
+// Buffers the kernel picks from for multishot receives, handed back once read.
+class buffer_ring {
+public:
+    buffer_ring() = default;
+    buffer_ring(const buffer_ring&) = delete;
+    buffer_ring& operator=(const buffer_ring&) = delete;
+
+    ~buffer_ring() {
+        if (ring_) munmap(ring_, count_ * sizeof(io_uring_buf));
+        if (buffers_) munmap(buffers_, count_ * size_);
+    }
+
+    // count must be a power of two.
+    bool open(uring& owner, std::uint16_t group, unsigned count, std::size_t size) noexcept {
+        count_ = count;
+        size_ = size;
+        void* ring = mmap(nullptr, count * sizeof(io_uring_buf), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        void* buffers = mmap(nullptr, count * size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        ring_ = ring == MAP_FAILED ? nullptr : static_cast<io_uring_buf_ring*>(ring);
+        buffers_ = buffers == MAP_FAILED ? nullptr : static_cast<std::byte*>(buffers);
+        if (!ring_ || !buffers_) return false;
+        io_uring_buf_reg registration{};
+        registration.ring_addr = reinterpret_cast<std::uint64_t>(ring_);
+        registration.ring_entries = count;
+        registration.bgid = group;
+        if (syscall(__NR_io_uring_register, owner.fd(), IORING_REGISTER_PBUF_RING, &registration, 1) != 0) return false;
+        for (unsigned id = 0; id < count; ++id) give_back(static_cast<std::uint16_t>(id));
+        return true;
+    }
+
+    std::byte* buffer(std::uint16_t id) const noexcept { return buffers_ + std::size_t{id} * size_; }
+
+    std::size_t size() const noexcept { return size_; }
+
+    void give_back(std::uint16_t id) noexcept {
+        // not ring_->bufs: the kernel header wraps it in an empty struct, which takes space in C++
+        io_uring_buf& entry = reinterpret_cast<io_uring_buf*>(ring_)[tail_ & (count_ - 1)];
+        entry.addr = reinterpret_cast<std::uint64_t>(buffer(id));
+        entry.len = static_cast<std::uint32_t>(size_);
+        entry.bid = id;
+        ++tail_;
+        std::atomic_ref{ring_->tail}.store(tail_, std::memory_order_release);
+    }
+
+private:
+    io_uring_buf_ring* ring_ = nullptr;
+    std::byte* buffers_ = nullptr;
+    unsigned count_ = 0;
+    std::size_t size_ = 0;
+    std::uint16_t tail_ = 0;
+};
+
+} // namespace nadi::uds
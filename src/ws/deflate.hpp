@@ -0,0 +1,90 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+#include <zlib.h>
+
+namespace nadi::ws {
+
+// permessage-deflate (RFC 7692) without context takeover in either direction, so every message
+// is compressed on its own and one stream serves all clients.
+
+class deflater {
+public:
+    deflater() {
+        stream_ = {};
+        // a low level: live streams are latency-bound and mostly small
+        ok_ = deflateInit2(&stream_, 1, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    }
+    ~deflater() {
+        if (ok_) deflateEnd(&stream_);
+    }
+    deflater(const deflater&) = delete;
+    deflater& operator=(const deflater&) = delete;
+
+    // Appends the compressed input, without the trailing empty block the extension omits.
+    bool compress(std::string_view input, std::string& out) {
+        if (!ok_ || deflateReset(&stream_) != Z_OK) return false;
+        std::size_t start = out.size();
+        stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+        stream_.avail_in = static_cast<uInt>(input.size());
+        do {
+            std::size_t used = out.size();
+            out.resize(used + deflateBound(&stream_, stream_.avail_in) + 16);
+            stream_.next_out = reinterpret_cast<Bytef*>(out.data() + used);
+            stream_.avail_out = static_cast<uInt>(out.size() - used);
+            if (deflate(&stream_, Z_SYNC_FLUSH) == Z_STREAM_ERROR) return false;
+            out.resize(out.size() - stream_.avail_out);
+        } while (stream_.avail_out == 0 || stream_.avail_in > 0);
+        if (out.size() - start < 4) return false;
+        out.resize(out.size() - 4);
+        return true;
+    }
+
+private:
+    z_stream stream_;
+    bool ok_;
+};
+
+class inflater {
+public:
+    inflater() {
+        stream_ = {};
+        ok_ = inflateInit2(&stream_, -15) == Z_OK;
+    }
+    ~inflater() {
+        if (ok_) inflateEnd(&stream_);
+    }
+    inflater(const inflater&) = delete;
+    inflater& operator=(const inflater&) = delete;
+
+    // Decompresses a whole message into out. Fails on corrupt input or beyond limit bytes.
+    bool decompress(std::string input, std::string& out, std::size_t limit) {
+        if (!ok_ || inflateReset(&stream_) != Z_OK) return false;
+        input.append("\x00\x00\xff\xff", 4);
+        out.clear();
+        stream_.next_in = reinterpret_cast<Bytef*>(input.data());
+        stream_.avail_in = static_cast<uInt>(input.size());
+        while (stream_.avail_in > 0) {
+            std::size_t used = out.size();
+            if (used >= limit) return false;
+            out.resize(std::min(limit, used + input.size() * 4 + 1024));
+            stream_.next_out = reinterpret_cast<Bytef*>(out.data() + used);
+            stream_.avail_out = static_cast<uInt>(out.size() - used);
+            int result = inflate(&stream_, Z_SYNC_FLUSH);
+            out.resize(out.size() - stream_.avail_out);
+            if (result != Z_OK && !(result == Z_BUF_ERROR && stream_.avail_out == 0) && result != Z_STREAM_END) return false;
+            if (result == Z_STREAM_END) break;
+        }
+        return true;
+    }
+
+private:
+    z_stream stream_;
+    bool ok_;
+};
+
+} // namespace nadi::ws
@@ -0,0 +1,652 @@
+// nadi_ws: NADI node serving the graph to WebSocket clients, such as dashboards, in the JSON form
+// of messages nadi_asyncapi.yaml describes. Messages sent to the gateway go to every client
+// subscribed to their channel; messages published by clients leave the gateway on the channel
+// they name. Each message is encoded once per client mode, and all frames pending for a client
+// are written together.
+
+#include "protocol.hpp"
+#ifdef NADI_WS_DEFLATE
+#include "deflate.hpp"
+#endif
+
+#include <nadi/descriptor_builder.hpp>
+#include <nadi/extended_message.hpp>
+#include <nadi/message_pool.hpp>
+#include <nadi/meta_registry.hpp>
+#include <nadi/nadi.h>
+#include <nadi/send_batch.hpp>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace nadi::ws {
+
+namespace {
+
+constexpr unsigned int configuration_channel = 0xF100;
+constexpr unsigned int reserved_channels = 0xF000; // and above, clients must not publish on them
+constexpr std::size_t max_handshake_size = 8 * 1024;
+constexpr std::size_t max_message_size = 16 << 20;
+constexpr std::size_t max_pending = 8 << 20;  // per client; beyond it, messages are dropped for that client
+constexpr std::size_t deflate_minimum = 256; // smaller messages are not worth compressing
+
+const descriptor node_descriptor =
+    descriptor_builder{"1.0.0"}
+        .description("Serves channels to WebSocket clients on localhost. Messages sent to any input channel other than "
+                     "0xF100 go to the clients subscribed to it; messages published by clients leave on the channel they name.")
+        .input(configuration_channel, "configuration", {"json"}, "ws.listen opens the server")
+        .output(configuration_channel, "configuration", {"json"}, "ws.listen.confirm")
+        .feature("send batch")
+        .feature("extended messages")
+        .build();
+
+struct client {
+    explicit client(int socket) noexcept : fd{socket} {}
+
+    const int fd;
+    // Guarded by the gateway's mutex, as senders read them.
+    bool open = false;
+    bool deflate = false;
+    bool binary = false;
+    bool all_channels = false;
+    std::vector<unsigned int> channels; // sorted
+    std::string pending;                // frames queued by senders
+    // I/O thread only.
+    std::string sending; // frames being written, from sent on
+    std::size_t sent = 0;
+    std::string input;
+    std::string message; // fragments of the message being received
+    std::uint8_t message_opcode = 0;
+    bool message_deflated = false;
+    bool closing = false; // no further input is read, and the connection ends once sending is flushed
+
+    bool subscribed(unsigned int channel) const noexcept {
+        return all_channels || std::binary_search(channels.begin(), channels.end(), channel);
+    }
+};
+
+class gateway {
+public:
+    gateway(nadi_node_handle handle, nadi_receive_callback receive) noexcept : handle_{handle}, receive_{receive} {}
+
+    void send(nadi_message** messages, std::size_t count, nadi_status* statuses) {
+        bool wake = false;
+        {
+            std::lock_guard lock{mutex_};
+            for (std::size_t i = 0; i < count; ++i) {
+                if (messages[i]->channel != configuration_channel) wake |= broadcast(messages[i]);
+            }
+        }
+        if (wake) signal();
+        for (std::size_t i = 0; i < count; ++i) {
+            if (messages[i]->channel == configuration_channel) {
+                statuses[i] = configure(messages[i]);
+            } else {
+                statuses[i] = NADI_OK;
+                messages[i]->free(messages[i]);
+            }
+        }
+    }
+
+    void stop() {
+        stopping_.store(true);
+        if (io_.joinable()) {
+            signal();
+            io_.join();
+        }
+        for (auto& c : clients_) close(c->fd);
+        if (listener_ >= 0) close(listener_);
+        if (wake_ >= 0) close(wake_);
+        delete this;
+    }
+
+private:
+    nadi_status configure(nadi_message* message) {
+        auto text = payload_view(*message);
+        auto request = nlohmann::json::parse(text.begin(), text.end(), nullptr, false);
+        auto type = request.is_object() ? request.find("type") : request.end();
+        if (type == request.end() || *type != "ws.listen") return NADI_INVALID_MESSAGE;
+        std::string error;
+        {
+            std::lock_guard lock{mutex_};
+            error = listener_ >= 0 ? "already listening" : listen(request);
+        }
+        nlohmann::json response{{"type", "ws.listen.confirm"}, {"status", error.empty() ? "success" : "error"}};
+        if (error.empty()) response["port"] = port_;
+        if (!error.empty()) response["error"] = error;
+        if (auto id = request.find("id"); id != request.end() && id->is_string()) response["id"] = *id;
+        message->free(message);
+        respond(response);
+        if (error.empty()) io_ = std::thread{[this] { run(); }};
+        return NADI_OK;
+    }
+
+    // Requires mutex_. Returns an error text, empty on success.
+    std::string listen(const nlohmann::json& request) {
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        auto host = request.find("address");
+        if (host != request.end() && (!host->is_string() || inet_pton(AF_INET, host->get_ref<const std::string&>().c_str(), &address.sin_addr) != 1)) {
+            return "address must be an IPv4 address";
+        }
+        if (host == request.end()) address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        auto port = request.find("port");
+        if (port != request.end() && (!port->is_number_unsigned() || port->get<std::uint64_t>() > 65535)) {
+            return "port must be 0 to 65535";
+        }
+        address.sin_port = htons(port == request.end() ? 0 : port->get<std::uint16_t>());
+
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) return "cannot create a socket";
+        int reuse = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        socklen_t length = sizeof(address);
+        if (bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || ::listen(fd, 16) != 0 ||
+            getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+            close(fd);
+            return "cannot listen on the address";
+        }
+        wake_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (wake_ < 0) {
+            close(fd);
+            return "cannot create an eventfd";
+        }
+        listener_ = fd;
+        port_ = ntohs(address.sin_port);
+        return {};
+    }
+
+    void respond(const nlohmann::json& response) {
+        static const interned_meta json = meta_registry::instance().intern("json");
+        std::string text = response.dump();
+        nadi_message* message = message_pool::instance().allocate(json, text.size() + 1);
+        std::memcpy(message->data, text.c_str(), text.size() + 1);
+        message->channel = configuration_channel;
+        message->node = handle_;
+        receive_(message);
+    }
+
+    void signal() noexcept {
+        std::uint64_t one = 1;
+        [[maybe_unused]] auto written = ::write(wake_, &one, sizeof(one));
+    }
+
+    // Requires mutex_. Queues the message for its subscribers and returns whether the I/O thread
+    // has to be woken for it.
+    bool broadcast(const nadi_message* message) {
+        std::string frames[4]; // by binary * 2 + deflate, built on first use
+        bool built[4] = {};
+        int spliced = -1; // whether text frames splice the payload in, checked once on first use
+        bool wake = false;
+        std::size_t size = payload_view(*message).size() + (message->meta ? std::strlen(message->meta) : 0);
+        if (size > max_pending) return false; // no client could queue it
+        for (auto& c : clients_) {
+            if (!c->open || !c->subscribed(message->channel)) continue;
+            int variant = c->binary * 2 + (c->deflate && size >= deflate_minimum);
+            if (!built[variant]) {
+                if (!c->binary && spliced < 0) spliced = is_json_text(*message);
+                encode(*message, c->binary, variant & 1, spliced > 0, frames[variant]);
+                built[variant] = true;
+            }
+            if (c->pending.size() + frames[variant].size() > max_pending) continue;
+            wake |= c->pending.empty();
+            c->pending += frames[variant];
+        }
+        return wake;
+    }
+
+    // Whether meta is "json" and the payload, without its null terminators, is empty or one JSON
+    // value, so text frames can splice it in as it is. Anything else falls back to base64.
+    static bool is_json_text(const nadi_message& message) {
+        if (!message.meta || std::strcmp(message.meta, "json") != 0) return false;
+        std::string_view data = payload_view(message);
+        while (!data.empty() && data.back() == '\0') data.remove_suffix(1);
+        return data.empty() || nlohmann::json::accept(data);
+    }
+
+    // Requires mutex_, for the shared deflate stream. splice is is_json_text(message).
+    void encode(const nadi_message& message, bool binary, bool deflate, bool splice, std::string& out) {
+        std::string_view meta = message.meta ? message.meta : "";
+        std::string_view data = payload_view(message);
+        std::string payload;
+        if (binary) {
+            payload.reserve(binary_prefix_size + meta.size() + data.size());
+            append_le32(payload, message.channel);
+            append_le32(payload, static_cast<std::uint32_t>(meta.size()));
+            payload += meta;
+            payload += data;
+        } else {
+            payload = R"({"channel":)" + std::to_string(message.channel) + R"(,"meta":)" + nlohmann::json(meta).dump();
+            if (splice) {
+                while (!data.empty() && data.back() == '\0') data.remove_suffix(1);
+                payload += R"(,"data":)";
+                payload += data;
+                if (data.empty()) payload += "null";
+            } else {
+                payload += R"(,"encoding":"base64","data":")";
+                append_base64(payload, data.data(), data.size());
+                payload += '"';
+            }
+            payload += '}';
+        }
+        std::uint8_t first_byte = fin_bit | (binary ? opcode::binary : opcode::text);
+#ifdef NADI_WS_DEFLATE
+        std::string compressed;
+        if (deflate && deflater_.compress(payload, compressed)) {
+            append_frame_header(out, first_byte | rsv1_bit, compressed.size());
+            out += compressed;
+            return;
+        }
+#else
+        (void)deflate;
+#endif
+        append_frame_header(out, first_byte, payload.size());
+        out += payload;
+    }
+
+    void run() {
+        std::vector<pollfd> polled;
+        while (!stopping_.load()) {
+            {
+                std::lock_guard lock{mutex_};
+                for (auto& c : clients_) {
+                    if (c->sending.size() == c->sent && !c->pending.empty()) {
+                        c->sending.clear();
+                        c->sent = 0;
+                        std::swap(c->sending, c->pending);
+                    }
+                }
+            }
+            for (auto& c : clients_) flush(*c);
+            drop_finished();
+
+            polled.assign({{wake_, POLLIN, 0}, {listener_, POLLIN, 0}});
+            for (auto& c : clients_) {
+                short events = c->closing ? 0 : POLLIN;
+                if (c->sent < c->sending.size()) events |= POLLOUT;
+                polled.push_back({c->fd, events, 0});
+            }
+            if (poll(polled.data(), polled.size(), -1) < 0 && errno != EINTR) break;
+            if (polled[0].revents & POLLIN) {
+                std::uint64_t count;
+                [[maybe_unused]] auto read = ::read(wake_, &count, sizeof(count));
+            }
+            if (polled[1].revents & POLLIN) accept_clients();
+            for (std::size_t i = 2; i < polled.size(); ++i) {
+                client& c = *clients_[i - 2];
+                if (polled[i].revents & POLLIN) {
+                    receive(c); // also notices the end of the connection
+                } else if (polled[i].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+                    c.closing = true;
+                    c.sending.clear();
+                    c.sent = 0;
+                }
+            }
+        }
+    }
+
+    void accept_clients() {
+        for (;;) {
+            int fd = accept4(listener_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) return;
+            std::lock_guard lock{mutex_};
+            clients_.push_back(std::make_unique<client>(fd));
+        }
+    }
+
+    void drop_finished() {
+        std::lock_guard lock{mutex_};
+        std::erase_if(clients_, [](const std::unique_ptr<client>& c) {
+            if (!c->closing || c->sent < c->sending.size()) return false;
+            close(c->fd);
+            return true;
+        });
+    }
+
+    // Writes as much of the client's frames as the socket takes.
+    static void flush(client& c) {
+        while (c.sent < c.sending.size()) {
+            ssize_t written = ::send(c.fd, c.sending.data() + c.sent, c.sending.size() - c.sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (written < 0 && errno == EINTR) continue;
+            if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+            if (written <= 0) {
+                c.closing = true;
+                c.sending.clear();
+                c.sent = 0;
+                return;
+            }
+            c.sent += static_cast<std::size_t>(written);
+        }
+    }
+
+    void receive(client& c) {
+        char buffer[64 * 1024];
+        for (;;) {
+            ssize_t received = ::recv(c.fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+            if (received < 0 && errno == EINTR) continue;
+            if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            if (received <= 0) {
+                c.closing = true;
+                return;
+            }
+            c.input.append(buffer, static_cast<std::size_t>(received));
+        }
+        if (!c.open) {
+            handshake(c);
+        }
+        if (c.open && !c.closing) read_frames(c);
+    }
+
+    void handshake(client& c) {
+        std::size_t end = c.input.find("\r\n\r\n");
+        if (end == std::string::npos) {
+            if (c.input.size() > max_handshake_size) reject(c);
+            return;
+        }
+        std::string_view request{c.input.data(), end + 2};
+        std::string key;
+        bool upgrade = false;
+        bool version = false;
+        bool deflate = false;
+        if (!request.starts_with("GET ")) return reject(c);
+        request.remove_prefix(request.find("\r\n") + 2);
+        while (!request.empty()) {
+            std::size_t line_end = request.find("\r\n");
+            std::string_view line = request.substr(0, line_end);
+            request.remove_prefix(line_end + 2);
+            std::size_t colon = line.find(':');
+            if (colon == std::string_view::npos) continue;
+            std::string name{line.substr(0, colon)};
+            std::transform(name.begin(), name.end(), name.begin(), [](unsigned char ch) { return std::tolower(ch); });
+            std::string_view value = line.substr(colon + 1);
+            while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) value.remove_prefix(1);
+            while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) value.remove_suffix(1);
+            std::string lowered{value};
+            std::transform(lowered.begin(), lowered.end(), lowered.begin(), [](unsigned char ch) { return std::tolower(ch); });
+            if (name == "upgrade") upgrade = lowered.find("websocket") != std::string::npos;
+            if (name == "sec-websocket-key") key = value;
+            if (name == "sec-websocket-version") version = value == "13";
+            // this end always compresses with the full window, so offers limiting it are declined
+            if (name == "sec-websocket-extensions" && lowered.find("permessage-deflate") != std::string::npos &&
+                lowered.find("server_max_window_bits") == std::string::npos) {
+                deflate = true;
+            }
+        }
+        if (!upgrade || !version || key.empty()) return reject(c);
+#ifndef NADI_WS_DEFLATE
+        deflate = false;
+#endif
+        c.input.erase(0, end + 4);
+        c.sending += "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: ";
+        c.sending += accept_key(key);
+        c.sending += "\r\n";
+        if (deflate) c.sending += "Sec-WebSocket-Extensions: permessage-deflate; server_no_context_takeover; client_no_context_takeover\r\n";
+        c.sending += "\r\n";
+        std::lock_guard lock{mutex_};
+        c.open = true;
+        c.deflate = deflate;
+    }
+
+    static void reject(client& c) {
+        c.sending += "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        c.closing = true;
+    }
+
+    void read_frames(client& c) {
+        std::size_t offset = 0;
+        frame f;
+        while (!c.closing && parse_frame(std::string_view{c.input}.substr(offset), f)) {
+            std::uint8_t code = f.first_byte & 0x0F;
+            bool fin = f.first_byte & fin_bit;
+            bool deflated = f.first_byte & rsv1_bit;
+            if (!f.masked || (f.first_byte & 0x30) || (deflated && (!c.deflate || code == opcode::continuation))) {
+                fail(c, 1002);
+                break;
+            }
+            if (f.length > max_message_size || c.message.size() + f.length > max_message_size) {
+                fail(c, 1009);
+                break;
+            }
+            if (c.input.size() - offset < f.header_size + f.length) break;
+            char* payload = c.input.data() + offset + f.header_size;
+            auto length = static_cast<std::size_t>(f.length);
+            unmask(payload, length, f.mask);
+            offset += f.header_size + length;
+
+            if (code & 0x8) {
+                if (!fin || length > 125) {
+                    fail(c, 1002);
+                } else if (code == opcode::close) {
+                    append_frame_header(c.sending, fin_bit | opcode::close, std::min<std::size_t>(length, 2));
+                    c.sending.append(payload, std::min<std::size_t>(length, 2));
+                    c.closing = true;
+                } else if (code == opcode::ping) {
+                    append_frame_header(c.sending, fin_bit | opcode::pong, length);
+                    c.sending.append(payload, length);
+                }
+                continue;
+            }
+            if ((code == opcode::continuation) == (c.message_opcode == 0) || (code != opcode::continuation && code != opcode::text && code != opcode::binary)) {
+                fail(c, 1002);
+                break;
+            }
+            if (code != opcode::continuation) {
+                c.message_opcode = code;
+                c.message_deflated = deflated;
+            }
+            c.message.append(payload, length);
+            if (!fin) continue;
+            deliver(c);
+            c.message.clear();
+            c.message_opcode = 0;
+        }
+        c.input.erase(0, offset);
+    }
+
+    void fail(client& c, std::uint16_t status) {
+        append_frame_header(c.sending, fin_bit | opcode::close, 2);
+        c.sending.push_back(static_cast<char>(status >> 8));
+        c.sending.push_back(static_cast<char>(status));
+        c.closing = true;
+    }
+
+    void deliver(client& c) {
+        std::string* content = &c.message;
+#ifdef NADI_WS_DEFLATE
+        std::string inflated;
+        if (c.message_deflated) {
+            if (!inflater_.decompress(std::move(c.message), inflated, max_message_size)) return fail(c, 1007);
+            content = &inflated;
+        }
+#endif
+        if (c.message_opcode == opcode::text) {
+            deliver_text(c, *content);
+        } else if (content->size() < binary_prefix_size || read_le32(content->data() + 4) > content->size() - binary_prefix_size) {
+            fail(c, 1007);
+        } else {
+            std::uint32_t meta_length = read_le32(content->data() + 4);
+            emit(c, read_le32(content->data()), std::string_view{content->data() + binary_prefix_size, meta_length},
+                 std::string_view{*content}.substr(binary_prefix_size + meta_length));
+        }
+    }
+
+    void deliver_text(client& c, const std::string& text) {
+        auto request = nlohmann::json::parse(text, nullptr, false);
+        if (!request.is_object()) return reply(c, {{"type", "ws.error"}, {"error", "messages are JSON objects"}});
+        auto type = request.find("type");
+        if (type != request.end() && (*type == "ws.subscribe" || *type == "ws.unsubscribe")) return subscribe(c, request, *type == "ws.subscribe");
+
+        auto channel = request.find("channel");
+        auto meta = request.find("meta");
+        auto data = request.find("data");
+        auto encoding = request.find("encoding");
+        if (channel == request.end() || !channel->is_number_unsigned() || channel->get<std::uint64_t>() > UINT_MAX ||
+            meta == request.end() || !meta->is_string() || data == request.end()) {
+            return reply(c, {{"type", "ws.error"}, {"error", "messages need channel, meta and data"}});
+        }
+        if (encoding != request.end()) {
+            std::string bytes;
+            if (*encoding != "base64" || !data->is_string() || !decode_base64(data->get_ref<const std::string&>(), bytes)) {
+                return reply(c, {{"type", "ws.error"}, {"error", "data must be a base64 string for encoding \"base64\""}});
+            }
+            return emit(c, channel->get<unsigned int>(), meta->get_ref<const std::string&>(), bytes);
+        }
+        std::string dumped = data->dump();
+        dumped.push_back('\0');
+        emit(c, channel->get<unsigned int>(), meta->get_ref<const std::string&>(), dumped);
+    }
+
+    void subscribe(client& c, const nlohmann::json& request, bool add) {
+        auto channels = request.find("channels");
+        auto binary = request.find("binary");
+        std::vector<unsigned int> listed;
+        bool valid = binary == request.end() || binary->is_boolean();
+        if (channels != request.end()) {
+            valid = valid && channels->is_array();
+            for (const auto& channel : valid ? *channels : nlohmann::json::array()) {
+                if (!channel.is_number_unsigned() || channel.get<std::uint64_t>() > UINT_MAX) valid = false;
+                if (valid) listed.push_back(channel.get<unsigned int>());
+            }
+        }
+        nlohmann::json response{{"type", add ? "ws.subscribe.confirm" : "ws.unsubscribe.confirm"},
+                                {"status", valid ? "success" : "error"}};
+        if (!valid) response["error"] = "channels must be an array of channel numbers and binary a boolean";
+        if (auto id = request.find("id"); id != request.end() && id->is_string()) response["id"] = *id;
+        if (valid) {
+            std::lock_guard lock{mutex_};
+            if (binary != request.end()) c.binary = binary->get<bool>();
+            if (channels == request.end()) {
+                c.all_channels = add;
+                if (!add) c.channels.clear();
+            } else if (add) {
+                c.channels.insert(c.channels.end(), listed.begin(), listed.end());
+                std::sort(c.channels.begin(), c.channels.end());
+                c.channels.erase(std::unique(c.channels.begin(), c.channels.end()), c.channels.end());
+            } else {
+                std::erase_if(c.channels, [&](unsigned int channel) { return std::find(listed.begin(), listed.end(), channel) != listed.end(); });
+            }
+        }
+        reply(c, response);
+    }
+
+    static void reply(client& c, const nlohmann::json& response) {
+        std::string text = response.dump();
+        append_frame_header(c.sending, fin_bit | opcode::text, text.size());
+        c.sending += text;
+    }
+
+    // Sends a message published by c, unless it names a reserved channel such as the gateway's own
+    // configuration output.
+    void emit(client& c, unsigned int channel, std::string_view meta, std::string_view data) {
+        if (channel >= reserved_channels) return reply(c, {{"type", "ws.error"}, {"error", "channels from 0xF000 on are reserved"}});
+        nadi_message* message = message_pool::instance().allocate(meta, data.size());
+        if (!data.empty()) std::memcpy(message->data, data.data(), data.size());
+        message->channel = channel;
+        message->node = handle_;
+        receive_(message);
+    }
+
+    const nadi_node_handle handle_;
+    const nadi_receive_callback receive_;
+    std::mutex mutex_; // clients_ and their subscriptions and pending frames
+    std::vector<std::unique_ptr<client>> clients_; // changed by the I/O thread only
+    int listener_ = -1;
+    int wake_ = -1;
+    std::uint16_t port_ = 0;
+    std::atomic<bool> stopping_{false};
+    std::thread io_;
+#ifdef NADI_WS_DEFLATE
+    deflater deflater_; // requires mutex_
+    inflater inflater_; // I/O thread only
+#endif
+};
+
+std::shared_mutex gateways_mutex;
+std::unordered_map<nadi_node_handle, gateway*> gateways;
+nadi_node_handle next_handle = 1;
+
+} // namespace
+
+} // namespace nadi::ws
+
+extern "C" {
+
+DLL_EXPORT nadi_status nadi_create(nadi_node_handle* node, nadi_receive_callback receive_callback) {
+    using namespace nadi::ws;
+    if (!node || !receive_callback) return NADI_INVALID_MESSAGE;
+    std::lock_guard lock{gateways_mutex};
+    *node = next_handle++;
+    gateways.emplace(*node, new gateway{*node, receive_callback});
+    return NADI_OK;
+}
+
+DLL_EXPORT nadi_status nadi_destroy(nadi_node_handle node) {
+    using namespace nadi::ws;
+    gateway* instance = nullptr;
+    {
+        std::lock_guard lock{gateways_mutex};
+        auto it = gateways.find(node);
+        if (it == gateways.end()) return NADI_INVALID_NODE;
+        instance = it->second;
+        gateways.erase(it);
+    }
+    instance->stop();
+    return NADI_OK;
+}
+
+DLL_EXPORT nadi_status nadi_send(nadi_message* message, nadi_node_handle node) {
+    using namespace nadi::ws;
+    if (!message) return NADI_INVALID_MESSAGE;
+    std::shared_lock lock{gateways_mutex};
+    auto it = gateways.find(node);
+    if (it == gateways.end()) return NADI_INVALID_NODE;
+    nadi_status status;
+    it->second->send(&message, 1, &status);
+    return status;
+}
+
+DLL_EXPORT nadi_status nadi_send_batch(nadi_message** messages, size_t count, nadi_node_handle node, nadi_status* statuses,
+                                       size_t* accepted) {
+    using namespace nadi::ws;
+    if (!accepted) return NADI_INVALID_MESSAGE;
+    *accepted = 0;
+    if (!messages || !statuses) return NADI_INVALID_MESSAGE;
+    std::shared_lock lock{gateways_mutex};
+    auto it = gateways.find(node);
+    if (it == gateways.end()) return NADI_INVALID_NODE;
+    it->second->send(messages, count, statuses);
+    return nadi::batch_status(statuses, count, accepted);
+}
+
+DLL_EXPORT void nadi_free(nadi_message* message) {
+    message->free(message);
+}
+
+DLL_EXPORT nadi_status nadi_descriptor(char* buffer, size_t* length) {
+    return nadi::ws::node_descriptor.write(buffer, length);
+}
+
+DLL_EXPORT nadi_status nadi_descriptor_view(const char** descriptor, size_t* length) {
+    return nadi::ws::node_descriptor.view(descriptor, length);
+}
+
+} // extern "C"
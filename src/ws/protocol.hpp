@@ -0,0 +1,192 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+namespace nadi::ws {
+
+// The parts of RFC 6455 the gateway needs: the opening handshake and framing. Everything here is
+// free of I/O, the gateway feeds it bytes and writes what it returns.
+
+namespace opcode {
+inline constexpr std::uint8_t continuation = 0x0;
+inline constexpr std::uint8_t text = 0x1;
+inline constexpr std::uint8_t binary = 0x2;
+inline constexpr std::uint8_t close = 0x8;
+inline constexpr std::uint8_t ping = 0x9;
+inline constexpr std::uint8_t pong = 0xA;
+} // namespace opcode
+
+inline constexpr std::uint8_t fin_bit = 0x80;
+inline constexpr std::uint8_t rsv1_bit = 0x40; // set on the first frame of a deflated message
+
+// Data in binary mode, in both directions: channel and meta length as little-endian 32-bit
+// integers, the meta without its null terminator, then the payload as is.
+inline constexpr std::size_t binary_prefix_size = 8;
+
+inline std::array<std::uint8_t, 20> sha1(std::string_view input) {
+    std::uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    std::string message{input};
+    std::uint64_t bits = std::uint64_t{input.size()} * 8;
+    message.push_back(static_cast<char>(0x80));
+    while (message.size() % 64 != 56) message.push_back('\0');
+    for (int i = 7; i >= 0; --i) message.push_back(static_cast<char>(bits >> (i * 8)));
+    auto rotate = [](std::uint32_t value, int count) { return (value << count) | (value >> (32 - count)); };
+    for (std::size_t chunk = 0; chunk < message.size(); chunk += 64) {
+        std::uint32_t w[80];
+        for (int i = 0; i < 16; ++i) {
+            const auto* p = reinterpret_cast<const unsigned char*>(message.data() + chunk + i * 4);
+            w[i] = std::uint32_t{p[0]} << 24 | std::uint32_t{p[1]} << 16 | std::uint32_t{p[2]} << 8 | p[3];
+        }
+        for (int i = 16; i < 80; ++i) w[i] = rotate(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        std::uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; ++i) {
+            std::uint32_t f, k;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            std::uint32_t next = rotate(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotate(b, 30);
+            b = a;
+            a = next;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+    std::array<std::uint8_t, 20> digest;
+    for (int i = 0; i < 20; ++i) digest[i] = static_cast<std::uint8_t>(h[i / 4] >> (24 - (i % 4) * 8));
+    return digest;
+}
+
+inline constexpr char base64_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+inline void append_base64(std::string& out, const void* data, std::size_t length) {
+    const auto* bytes = static_cast<const unsigned char*>(data);
+    for (std::size_t i = 0; i < length; i += 3) {
+        std::uint32_t group = std::uint32_t{bytes[i]} << 16;
+        if (i + 1 < length) group |= std::uint32_t{bytes[i + 1]} << 8;
+        if (i + 2 < length) group |= bytes[i + 2];
+        out.push_back(base64_alphabet[group >> 18]);
+        out.push_back(base64_alphabet[(group >> 12) & 63]);
+        out.push_back(i + 1 < length ? base64_alphabet[(group >> 6) & 63] : '=');
+        out.push_back(i + 2 < length ? base64_alphabet[group & 63] : '=');
+    }
+}
+
+// Returns false on characters outside the alphabet or a bad length.
+inline bool decode_base64(std::string_view text, std::string& out) {
+    if (text.size() % 4 != 0) return false;
+    auto value = [](char c) -> int {
+        if (c >= 'A' && c <= 'Z') return c - 'A';
+        if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+        if (c >= '0' && c <= '9') return c - '0' + 52;
+        if (c == '+') return 62;
+        if (c == '/') return 63;
+        return -1;
+    };
+    for (std::size_t i = 0; i < text.size(); i += 4) {
+        int padding = (text[i + 3] == '=') + (text[i + 2] == '=' && text[i + 3] == '=');
+        if (padding > 0 && i + 4 != text.size()) return false;
+        std::uint32_t group = 0;
+        for (int j = 0; j < 4 - padding; ++j) {
+            int v = value(text[i + j]);
+            if (v < 0) return false;
+            group |= std::uint32_t(v) << (18 - 6 * j);
+        }
+        out.push_back(static_cast<char>(group >> 16));
+        if (padding < 2) out.push_back(static_cast<char>(group >> 8));
+        if (padding < 1) out.push_back(static_cast<char>(group));
+    }
+    return true;
+}
+
+// Value of Sec-WebSocket-Accept for the client's Sec-WebSocket-Key.
+inline std::string accept_key(std::string_view key) {
+    std::string input{key};
+    input += "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    auto digest = sha1(input);
+    std::string out;
+    append_base64(out, digest.data(), digest.size());
+    return out;
+}
+
+// Appends an unmasked frame header, as servers send them.
+inline void append_frame_header(std::string& out, std::uint8_t first_byte, std::size_t length) {
+    out.push_back(static_cast<char>(first_byte));
+    if (length < 126) {
+        out.push_back(static_cast<char>(length));
+    } else if (length <= 0xFFFF) {
+        out.push_back(126);
+        out.push_back(static_cast<char>(length >> 8));
+        out.push_back(static_cast<char>(length));
+    } else {
+        out.push_back(127);
+        for (int i = 7; i >= 0; --i) out.push_back(static_cast<char>(std::uint64_t{length} >> (i * 8)));
+    }
+}
+
+inline void append_le32(std::string& out, std::uint32_t value) {
+    for (int i = 0; i < 4; ++i) out.push_back(static_cast<char>(value >> (i * 8)));
+}
+
+inline std::uint32_t read_le32(const char* bytes) {
+    const auto* p = reinterpret_cast<const unsigned char*>(bytes);
+    return std::uint32_t{p[0]} | std::uint32_t{p[1]} << 8 | std::uint32_t{p[2]} << 16 | std::uint32_t{p[3]} << 24;
+}
+
+struct frame {
+    std::uint8_t first_byte; // fin, rsv and opcode
+    std::size_t header_size;
+    std::uint64_t length;
+    bool masked;
+    std::array<char, 4> mask;
+};
+
+// Parses the frame header at the start of bytes. Returns false if more bytes are needed.
+inline bool parse_frame(std::string_view bytes, frame& out) {
+    if (bytes.size() < 2) return false;
+    const auto* p = reinterpret_cast<const unsigned char*>(bytes.data());
+    out.first_byte = p[0];
+    out.masked = p[1] & 0x80;
+    out.length = p[1] & 0x7F;
+    std::size_t size = 2;
+    if (out.length == 126 || out.length == 127) {
+        std::size_t extra = out.length == 126 ? 2 : 8;
+        if (bytes.size() < size + extra) return false;
+        out.length = 0;
+        for (std::size_t i = 0; i < extra; ++i) out.length = out.length << 8 | p[size + i];
+        size += extra;
+    }
+    if (out.masked) {
+        if (bytes.size() < size + 4) return false;
+        std::memcpy(out.mask.data(), bytes.data() + size, 4);
+        size += 4;
+    }
+    out.header_size = size;
+    return true;
+}
+
+inline void unmask(char* payload, std::size_t length, const std::array<char, 4>& mask) {
+    for (std::size_t i = 0; i < length; ++i) payload[i] ^= mask[i % 4];
+}
+
+} // namespace nadi::ws
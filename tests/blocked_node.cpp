@@ -0,0 +1,44 @@
+// Test node that never accepts a message: nadi_send always answers NADI_WOULD_BLOCK and the node
+// never emits, so its mailbox stays parked and whatever is connected to it fills up.
+
+#include <nadi/descriptor_builder.hpp>
+#include <nadi/nadi.h>
+
+#include <atomic>
+
+namespace {
+
+const nadi::descriptor node_descriptor = nadi::descriptor_builder{"1.0.0"}.input(0, "in").build();
+
+std::atomic<nadi_node_handle> next_handle{1};
+
+} // namespace
+
+extern "C" {
+
+DLL_EXPORT nadi_status nadi_create(nadi_node_handle* node, nadi_receive_callback) {
+    *node = next_handle.fetch_add(1);
+    return NADI_OK;
+}
+
+DLL_EXPORT nadi_status nadi_destroy(nadi_node_handle) {
+    return NADI_OK;
+}
+
+DLL_EXPORT nadi_status nadi_send(nadi_message*, nadi_node_handle) {
+    return NADI_WOULD_BLOCK;
+}
+
+DLL_EXPORT void nadi_free(nadi_message* message) {
+    message->free(message);
+}
+
+DLL_EXPORT nadi_status nadi_descriptor(char* buffer, size_t* length) {
+    return node_descriptor.write(buffer, length);
+}
+
+DLL_EXPORT nadi_status nadi_descriptor_view(const char** descriptor, size_t* length) {
+    return node_descriptor.view(descriptor, length);
+}
+
+} // extern "C"
@@ -0,0 +1,100 @@
+// Checks that a sender waiting on a full "block" queue holds up neither context.disconnect nor
+// context.node.destroy: the queue's destination never takes a message, the disconnect must still
+// be confirmed, and the waiting sender must return.
+
+#include <nadi/context.hpp>
+#include <nadi/message_pool.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace {
+
+constexpr unsigned int command_channel = 0xF000;
+constexpr unsigned int response_channel = 100;
+constexpr int sent_messages = 100; // more than a mailbox batch deferred by the node plus one queued
+
+std::mutex mutex;
+std::condition_variable changed;
+std::deque<std::string> responses;
+bool sender_done = false;
+
+void receive(nadi_message* message) {
+    if (message->channel == response_channel) {
+        std::string text{static_cast<const char*>(message->data), message->data_length};
+        while (!text.empty() && text.back() == '\0') text.pop_back();
+        std::lock_guard lock{mutex};
+        responses.push_back(std::move(text));
+    }
+    message->free(message);
+    changed.notify_all();
+}
+
+nadi_message* make_message(unsigned int channel, const std::string& text) {
+    nadi_message* message = nadi::message_pool::instance().allocate("json", text.size() + 1);
+    std::memcpy(message->data, text.c_str(), text.size() + 1);
+    message->channel = channel;
+    message->node = 0;
+    return message;
+}
+
+// A hang is the failure this test looks for, so it exits without destroying the context
+[[noreturn]] void fail(const std::string& what) {
+    std::fprintf(stderr, "%s\n", what.c_str());
+    std::_Exit(1);
+}
+
+void command(nadi::context& context, const std::string& text) {
+    context.send(make_message(command_channel, text), 0);
+    std::unique_lock lock{mutex};
+    if (!changed.wait_for(lock, std::chrono::seconds{5}, [] { return !responses.empty(); })) fail("no response to " + text);
+    std::string response = std::move(responses.front());
+    responses.pop_front();
+    if (response.find("\"node\":0") != std::string::npos || response.find("error") != std::string::npos) {
+        fail(text + " failed: " + response);
+    }
+}
+
+} // namespace
+
+int main() {
+    nadi::context context{receive, 1};
+    context.add_abstract_node("blocked", NADI_TEST_BLOCKED_NODE);
+    context.send(make_message(command_channel, R"({"type":"context.connect","source":[0,61440],"destination":[0,100],"id":"r"})"), 0);
+    {
+        std::unique_lock lock{mutex};
+        changed.wait_for(lock, std::chrono::seconds{5}, [] { return !responses.empty(); });
+        responses.clear();
+    }
+    command(context, R"({"type":"context.node.create","abstract_name":"blocked","instance_name":"b","id":"c"})");
+    command(context, R"({"type":"context.connect","source":[0,2],"destination":["b",0],"queue":{"capacity":1,"policy":"block"},"id":"1"})");
+
+    std::thread sender{[&] {
+        for (int i = 0; i < sent_messages; ++i) context.route(make_message(2, "{}"));
+        {
+            std::lock_guard lock{mutex};
+            sender_done = true;
+        }
+        changed.notify_all();
+    }};
+    {
+        std::unique_lock lock{mutex};
+        if (changed.wait_for(lock, std::chrono::milliseconds{200}, [] { return sender_done; })) fail("the sender did not block");
+    }
+
+    command(context, R"({"type":"context.disconnect","source":[0,2],"destination":["b",0],"id":"2"})");
+    {
+        std::unique_lock lock{mutex};
+        if (!changed.wait_for(lock, std::chrono::seconds{5}, [] { return sender_done; })) fail("the sender still waits after the disconnect");
+    }
+    sender.join();
+    command(context, R"({"type":"context.node.destroy","instance_name":"b","id":"3"})");
+    return 0;
+}
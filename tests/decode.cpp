@@ -0,0 +1,122 @@
+// Decodes one message of every kind from raw JSON text with the one-pass decoder, under the
+// language standard of the nadi target, and checks that raw text cannot reach the DOM overload.
+
+#include <nadi/messages.hpp>
+
+#include <concepts>
+#include <cstdint>
+#include <cstdio>
+#include <span>
+#include <string_view>
+#include <variant>
+
+namespace messages = nadi::messages;
+
+namespace {
+
+template <class Arg>
+constexpr bool decodes_raw = requires(Arg arg) {
+    { messages::decode<messages::node_connect>(arg) } -> std::same_as<messages::decode_result<messages::node_connect>>;
+};
+
+template <class Arg>
+constexpr bool decodes = requires(Arg arg) { messages::decode<messages::node_connect>(arg); };
+
+static_assert(decodes_raw<std::span<const char>>);
+static_assert(decodes_raw<std::string_view>);
+static_assert(!decodes<const char*>);
+static_assert(decodes<const nlohmann::json&>);
+
+int failures = 0;
+
+bool check(bool ok, const char* what, int line) {
+    if (ok) return true;
+    std::fprintf(stderr, "decode.cpp:%d: %s\n", line, what);
+    ++failures;
+    return false;
+}
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+template <class T>
+messages::decode_result<T> decode(std::string_view text) {
+    return messages::decode<T>(std::span<const char>{text.data(), text.size()});
+}
+
+} // namespace
+
+int main() {
+    if (auto m = decode<messages::context_abstract_nodes>(R"({"type":"context.abstract_nodes","id":"a-1"})"); CHECK(m.has_value())) {
+        CHECK(m->id == "a-1");
+    }
+    if (auto m = decode<messages::context_abstract_nodes_list>(
+            R"({"type":"context.abstract_nodes.list","id":"a-1","instances":[{"name":"nadi_shm","version":"1.0.0",)"
+            R"("channels":{"input":[{"number":61696,"name":"configuration","data types":["json"]}],"output":[]}}]})");
+        CHECK(m.has_value())) {
+        CHECK(m->instances.size() == 1 && m->instances[0].name == "nadi_shm");
+        CHECK(m->instances[0].channels && m->instances[0].channels->input && m->instances[0].channels->input->at(0).number == 0xF100);
+    }
+    if (auto m = decode<messages::context_connect>(
+            R"({"type":"context.connect","source":["camera",1],"destination":[7,0],"queue":{"capacity":64,"policy":"latest"}})");
+        CHECK(m.has_value())) {
+        CHECK(std::get<std::string_view>(m->source.first) == "camera" && m->source.second == 1);
+        CHECK(std::get<std::int64_t>(m->destination.first) == 7);
+        CHECK(m->queue && m->queue->capacity == 64 && m->queue->policy == "latest");
+        CHECK(!m->id);
+    }
+    CHECK(decode<messages::context_connect_confirm>(R"({"type":"context.connect.confirm","status":"success","id":"c-1"})").has_value());
+    CHECK(decode<messages::context_connections>(R"({"type":"context.connections","id":"c-2"})").has_value());
+    if (auto m = decode<messages::context_connections_list>(
+            R"({"type":"context.connections.list","id":"c-2","connections":[{"source":[3,1],"target":["display",0],)"
+            R"("queue":{"capacity":8,"policy":"block","dropped":0}}]})");
+        CHECK(m.has_value())) {
+        CHECK(m->connections.size() == 1 && std::get<std::string_view>(m->connections[0].target.first) == "display");
+        CHECK(m->connections[0].queue && m->connections[0].queue->dropped == 0);
+    }
+    CHECK(decode<messages::context_disconnect>(R"({"type":"context.disconnect","source":["camera",1],"destination":[7,0]})").has_value());
+    CHECK(decode<messages::context_disconnect_confirm>(R"({"type":"context.disconnect.confirm","status":"success"})").has_value());
+    if (auto m = decode<messages::context_node_create>(
+            R"({"type":"context.node.create","abstract_name":"nadi_shm","instance_name":"shm_0","affinity":2})");
+        CHECK(m.has_value())) {
+        CHECK(m->abstract_name == "nadi_shm" && m->instance_name == "shm_0" && m->affinity == 2);
+    }
+    CHECK(decode<messages::context_node_create_confirm>(
+              R"({"type":"context.node.create.confirm","node":3,"instance_name":"shm_0","id":"n-1"})")
+              .has_value());
+    CHECK(decode<messages::context_node_destroy>(R"({"type":"context.node.destroy","instance_name":"shm_0"})").has_value());
+    CHECK(decode<messages::context_node_destroy_confirm>(R"({"type":"context.node.destroy.confirm","status":"success"})").has_value());
+    CHECK(decode<messages::context_nodes>(R"({"type":"context.nodes","id":"n-2"})").has_value());
+    if (auto m = decode<messages::context_nodes_list>(R"({"type":"context.nodes.list","id":"n-2","instances":[{"instance":"shm_0"}]})");
+        CHECK(m.has_value())) {
+        CHECK(m->instances.size() == 1 && m->instances[0].instance == "shm_0");
+    }
+    if (auto m = decode<messages::node_connect>(R"({"type":"node.connect","source":[3,1],"target":0})"); CHECK(m.has_value())) {
+        CHECK(m->source.size() == 2 && m->source[0] == 3 && m->source[1] == 1 && m->target == 0);
+    }
+    CHECK(decode<messages::node_connect_confirm>(R"({"type":"node.connect.confirm","status":"success","id":"c-3"})").has_value());
+    if (auto m = decode<messages::node_credit>(R"({"type":"node.credit","channel":1,"credits":32})"); CHECK(m.has_value())) {
+        CHECK(m->channel == 1 && m->credits == 32);
+    }
+    CHECK(decode<messages::node_disconnect>(R"({"type":"node.disconnect","source":[3,1],"target":0})").has_value());
+    CHECK(decode<messages::node_disconnect_confirm>(
+              R"({"type":"node.disconnect.confirm","status":"failure","message":"not connected","id":"d-1"})")
+              .has_value());
+
+    // Rejections carry their reason
+    CHECK(decode<messages::node_connect>(R"({"type":"node.connect","target":0)").error() == messages::decode_error::syntax);
+    CHECK(decode<messages::node_connect>(R"({"type":"node.connect","source":[3,1],"target":"0"})").error() == messages::decode_error::wrong_type);
+    CHECK(decode<messages::node_connect>(R"({"type":"node.disconnect","source":[3,1],"target":0})").error() == messages::decode_error::wrong_message);
+    CHECK(decode<messages::node_connect>(R"({"type":"node.connect","source":[3,1]})").error() == messages::decode_error::missing_member);
+
+    // The schema's minimum and enum hold for the decoders and the generated validators alike
+    for (std::string_view text : {R"({"type":"context.connect","source":[0,1],"destination":[7,0],"queue":{"capacity":0,"policy":"block"}})",
+                                  R"({"type":"context.connect","source":[0,1],"destination":[7,0],"queue":{"capacity":8,"policy":"spill_to_disk"}})"}) {
+        CHECK(decode<messages::context_connect>(text).error() == messages::decode_error::wrong_value);
+        CHECK(!messages::decode<messages::context_connect>(nlohmann::json::parse(text)));
+        CHECK(!nadi::validation::validate_context_connect(text.data(), text.size()));
+        CHECK(!nadi::validation::validate_context_connect(nlohmann::json::parse(text)));
+    }
+
+    if (failures) std::fprintf(stderr, "%d checks failed\n", failures);
+    return failures ? 1 : 0;
+}
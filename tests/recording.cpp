@@ -0,0 +1,204 @@
+// Records messages with nadi_recorder into a temporary directory, through the node API as a host
+// would, and replays them with nadi_replay: the recording must roll over into further segments,
+// replay must return every record with its channel, meta, meta_hash and bytes, and replay.seek
+// must land on the first record at or after the requested timestamp.
+
+#include <nadi/message_pool.hpp>
+#include <nadi/nadi.h>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dlfcn.h>
+
+namespace {
+
+constexpr unsigned int configuration_channel = 0xF100;
+constexpr int recorded_messages = 30;
+constexpr std::size_t payload_size = 90000; // about ten records per segment of 1 MiB
+
+struct node_api {
+    decltype(&nadi_create) create = nullptr;
+    decltype(&nadi_destroy) destroy = nullptr;
+    decltype(&nadi_send) send = nullptr;
+};
+
+struct record {
+    unsigned int channel;
+    std::string meta;
+    std::uint64_t meta_hash;
+    std::string data;
+};
+
+std::mutex mutex;
+std::condition_variable changed;
+std::deque<nlohmann::json> responses;
+std::vector<record> replayed;
+
+int failures = 0;
+
+bool check(bool ok, const char* what, int line) {
+    if (ok) return true;
+    std::fprintf(stderr, "recording.cpp:%d: %s\n", line, what);
+    ++failures;
+    return false;
+}
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+// A hang is a failure as well, so it exits without tearing the nodes down
+[[noreturn]] void fail(const std::string& what) {
+    std::fprintf(stderr, "%s\n", what.c_str());
+    std::_Exit(1);
+}
+
+void receive(nadi_message* message) {
+    {
+        std::lock_guard lock{mutex};
+        if (message->channel == configuration_channel) {
+            responses.push_back(nlohmann::json::parse(static_cast<const char*>(message->data)));
+        } else {
+            replayed.push_back({message->channel, message->meta, message->meta_hash,
+                                std::string{static_cast<const char*>(message->data), message->data_length}});
+        }
+    }
+    message->free(message);
+    changed.notify_all();
+}
+
+node_api load(const char* path) {
+    void* library = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (!library) fail(std::string{"cannot load "} + path);
+    node_api api;
+    api.create = reinterpret_cast<decltype(api.create)>(dlsym(library, "nadi_create"));
+    api.destroy = reinterpret_cast<decltype(api.destroy)>(dlsym(library, "nadi_destroy"));
+    api.send = reinterpret_cast<decltype(api.send)>(dlsym(library, "nadi_send"));
+    if (!api.create || !api.destroy || !api.send) fail(std::string{"not a NADI library: "} + path);
+    return api;
+}
+
+nadi_message* make_message(unsigned int channel, const std::string& meta, std::uint64_t meta_hash, const std::string& data) {
+    nadi_message* message = nadi::message_pool::instance().allocate(meta, data.size());
+    std::memcpy(message->data, data.data(), data.size());
+    message->meta_hash = meta_hash;
+    message->channel = channel;
+    return message;
+}
+
+// Waits for a response of type. The player thread reports replay.finished, which may overtake
+// the confirmation of replay.play.
+nlohmann::json response(const std::string& type) {
+    std::unique_lock lock{mutex};
+    auto found = responses.end();
+    auto arrived = [&] {
+        found = std::find_if(responses.begin(), responses.end(), [&](const nlohmann::json& r) { return r.value("type", "") == type; });
+        return found != responses.end();
+    };
+    if (!changed.wait_for(lock, std::chrono::seconds{5}, arrived)) fail("no " + type);
+    nlohmann::json result = std::move(*found);
+    responses.erase(found);
+    return result;
+}
+
+nlohmann::json command(const node_api& api, nadi_node_handle node, const nlohmann::json& request) {
+    std::string text = request.dump();
+    if (api.send(make_message(configuration_channel, "json", 0, text + '\0'), node) != NADI_OK) fail("rejected " + text);
+    nlohmann::json result = response(request["type"].get<std::string>() + ".confirm");
+    if (result.value("status", "") != "success") fail(text + " failed: " + result.dump());
+    return result;
+}
+
+// Plays from the current position to the end, returning what was replayed.
+std::vector<record> play(const node_api& api, nadi_node_handle node) {
+    {
+        std::lock_guard lock{mutex};
+        replayed.clear();
+    }
+    command(api, node, {{"type", "replay.play"}, {"speed", 0}});
+    response("replay.finished");
+    std::lock_guard lock{mutex};
+    return std::move(replayed);
+}
+
+std::uint64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+int main() {
+    std::string pattern = (std::filesystem::temp_directory_path() / "nadi-recording-XXXXXX").string();
+    if (!mkdtemp(pattern.data())) fail("cannot create a temporary directory");
+    std::filesystem::path directory = pattern;
+
+    node_api recorder = load(NADI_TEST_RECORDER);
+    node_api replay = load(NADI_TEST_REPLAY);
+
+    std::vector<record> sent;
+    std::vector<std::uint64_t> sent_at; // wall clock right before each record was sent
+    nadi_node_handle node;
+    if (recorder.create(&node, receive) != NADI_OK) fail("cannot create the recorder");
+    command(recorder, node,
+            {{"type", "recorder.open"}, {"directory", directory.string()}, {"segment_size", 1 << 20}, {"index_interval", 256 << 10}});
+    for (int i = 0; i < recorded_messages; ++i) {
+        record r{1 + static_cast<unsigned int>(i % 3), "m" + std::to_string(i), 0, std::string(payload_size + i * 100, '\0')};
+        for (std::size_t j = 0; j < r.data.size(); ++j) r.data[j] = static_cast<char>(i * 31 + j);
+        // a hash set by the sender is kept, an unset one is computed by the recorder
+        std::uint64_t meta_hash = i % 2 ? 0 : 1000 + i;
+        r.meta_hash = meta_hash ? meta_hash : nadi_meta_hash(r.meta.c_str());
+        std::this_thread::sleep_for(std::chrono::milliseconds{1}); // keeps timestamps apart from sent_at
+        sent_at.push_back(now());
+        if (recorder.send(make_message(r.channel, r.meta, meta_hash, r.data), node) != NADI_OK) fail("cannot record " + r.meta);
+        sent.push_back(std::move(r));
+    }
+    nlohmann::json totals = command(recorder, node, {{"type", "recorder.close"}});
+    recorder.destroy(node);
+
+    CHECK(totals.value("records", 0) == recorded_messages);
+    CHECK(totals.value("segments", 0) >= 2);
+    int segment_files = 0;
+    for (const auto& entry : std::filesystem::directory_iterator{directory}) segment_files += entry.path().extension() == ".nadirec";
+    CHECK(segment_files == totals.value("segments", 0));
+
+    if (replay.create(&node, receive) != NADI_OK) fail("cannot create the replay node");
+    nlohmann::json opened = command(replay, node, {{"type", "replay.open"}, {"directory", directory.string()}});
+    CHECK(opened.value("segments", 0) == segment_files);
+    CHECK(opened.value("begin", std::uint64_t{0}) >= sent_at.front());
+
+    std::vector<record> all = play(replay, node);
+    if (CHECK(all.size() == sent.size())) {
+        for (std::size_t i = 0; i < all.size(); ++i) {
+            CHECK(all[i].channel == sent[i].channel);
+            CHECK(all[i].meta == sent[i].meta);
+            CHECK(all[i].meta_hash == sent[i].meta_hash);
+            CHECK(all[i].data == sent[i].data);
+        }
+    }
+
+    // into the first segment, across a segment boundary and to the last record
+    for (int target : {0, 4, 12, 21, recorded_messages - 1}) {
+        nlohmann::json sought = command(replay, node, {{"type", "replay.seek"}, {"timestamp", sent_at[target]}});
+        CHECK(sought.value("timestamp", std::uint64_t{0}) >= sent_at[target]);
+        std::vector<record> rest = play(replay, node);
+        if (CHECK(rest.size() == sent.size() - target)) CHECK(rest.front().meta == sent[target].meta);
+    }
+    nlohmann::json past = command(replay, node, {{"type", "replay.seek"}, {"timestamp", now()}});
+    CHECK(!past.contains("timestamp"));
+
+    command(replay, node, {{"type", "replay.close"}});
+    replay.destroy(node);
+    std::filesystem::remove_all(directory);
+    return failures == 0 ? 0 : 1;
+}
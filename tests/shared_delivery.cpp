@@ -0,0 +1,108 @@
+// Checks that the context hands nodes listing "shared messages" a nadi_shared_message for every
+// delivery: sent by the host, routed to a single destination, and fanned out to two.
+
+#include <nadi/context.hpp>
+#include <nadi/message_pool.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+
+namespace {
+
+constexpr unsigned int command_channel = 0xF000;
+constexpr unsigned int response_channel = 100;
+
+std::mutex mutex;
+std::condition_variable changed;
+std::deque<std::string> responses;
+int shared_results = 0;
+int plain_results = 0;
+
+void receive(nadi_message* message) {
+    {
+        std::lock_guard lock{mutex};
+        if (message->channel == response_channel) {
+            std::string text{static_cast<const char*>(message->data), message->data_length};
+            while (!text.empty() && text.back() == '\0') text.pop_back();
+            responses.push_back(std::move(text));
+        } else if (message->channel == 1 && message->data_length == 1) {
+            ++(*static_cast<const char*>(message->data) ? shared_results : plain_results);
+        }
+    }
+    message->free(message);
+    changed.notify_all();
+}
+
+nadi_message* make_message(unsigned int channel, const std::string& text) {
+    nadi_message* message = nadi::message_pool::instance().allocate("json", text.size() + 1);
+    std::memcpy(message->data, text.c_str(), text.size() + 1);
+    message->channel = channel;
+    message->node = 0;
+    return message;
+}
+
+// Zeroed payload, so a plain header read as a shared one has no share
+nadi_message* make_payload(unsigned int channel) {
+    nadi_message* message = nadi::message_pool::instance().allocate("test", 16);
+    std::memset(message->data, 0, 16);
+    message->channel = channel;
+    message->node = 0;
+    return message;
+}
+
+bool command(nadi::context& context, const std::string& text) {
+    context.send(make_message(command_channel, text), 0);
+    std::unique_lock lock{mutex};
+    if (!changed.wait_for(lock, std::chrono::seconds{5}, [] { return !responses.empty(); })) {
+        std::fprintf(stderr, "no response to %s\n", text.c_str());
+        return false;
+    }
+    std::string response = std::move(responses.front());
+    responses.pop_front();
+    if (response.find("\"node\":0") != std::string::npos || response.find("error") != std::string::npos) {
+        std::fprintf(stderr, "%s failed: %s\n", text.c_str(), response.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool wait_for_results(int count) {
+    std::unique_lock lock{mutex};
+    return changed.wait_for(lock, std::chrono::seconds{5}, [&] { return shared_results + plain_results >= count; });
+}
+
+} // namespace
+
+int main() {
+    nadi::context context{receive, 2};
+    context.add_abstract_node("shared", NADI_TEST_SHARED_NODE);
+    // The response to this first connect already takes the new route
+    context.send(make_message(command_channel, R"({"type":"context.connect","source":[0,61440],"destination":[0,100],"id":"r"})"), 0);
+    {
+        std::unique_lock lock{mutex};
+        changed.wait_for(lock, std::chrono::seconds{5}, [] { return !responses.empty(); });
+        responses.clear();
+    }
+    bool ok = command(context, R"({"type":"context.node.create","abstract_name":"shared","instance_name":"s","id":"c"})") &&
+              command(context, R"({"type":"context.connect","source":["s",1],"destination":[0,1],"id":"1"})") &&
+              command(context, R"({"type":"context.connect","source":[0,2],"destination":["s",0],"id":"2"})") &&
+              command(context, R"({"type":"context.connect","source":[0,3],"destination":["s",0],"id":"3"})") &&
+              command(context, R"({"type":"context.connect","source":[0,3],"destination":["s",4],"id":"4"})");
+    if (!ok) return 1;
+
+    if (context.send(make_payload(0), 1) != NADI_OK) return 1;
+    context.route(make_payload(2));
+    context.route(make_payload(3));
+    if (!wait_for_results(4)) {
+        std::fprintf(stderr, "got %d of 4 results\n", shared_results + plain_results);
+        return 1;
+    }
+    std::lock_guard lock{mutex};
+    if (plain_results) std::fprintf(stderr, "%d of 4 deliveries were plain headers\n", plain_results);
+    return plain_results || shared_results != 4 ? 1 : 0;
+}
@@ -0,0 +1,78 @@
+// Test node listing "shared messages": checks that every message it gets is a nadi_shared_message
+// with a live share, retains and releases it, and reports the result on output channel 1 as one
+// byte, 1 for a shared header and 0 otherwise.
+
+#include <nadi/descriptor_builder.hpp>
+#include <nadi/message_pool.hpp>
+#include <nadi/nadi.h>
+
+#include <mutex>
+#include <unordered_map>
+
+namespace {
+
+const nadi::descriptor node_descriptor =
+    nadi::descriptor_builder{"1.0.0"}
+        .input(0, "in")
+        .input(4, "in 2")
+        .output(1, "result")
+        .feature("shared messages")
+        .build();
+
+std::mutex nodes_mutex;
+std::unordered_map<nadi_node_handle, nadi_receive_callback> nodes;
+nadi_node_handle next_handle = 1;
+
+} // namespace
+
+extern "C" {
+
+DLL_EXPORT nadi_status nadi_create(nadi_node_handle* node, nadi_receive_callback receive_callback) {
+    std::lock_guard lock{nodes_mutex};
+    *node = next_handle++;
+    nodes.emplace(*node, receive_callback);
+    return NADI_OK;
+}
+
+DLL_EXPORT nadi_status nadi_destroy(nadi_node_handle node) {
+    std::lock_guard lock{nodes_mutex};
+    return nodes.erase(node) ? NADI_OK : NADI_INVALID_NODE;
+}
+
+DLL_EXPORT nadi_status nadi_send(nadi_message* message, nadi_node_handle node) {
+    nadi_receive_callback receive = nullptr;
+    {
+        std::lock_guard lock{nodes_mutex};
+        auto it = nodes.find(node);
+        if (it == nodes.end()) return NADI_INVALID_NODE;
+        receive = it->second;
+    }
+    auto* shared = reinterpret_cast<nadi_shared_message*>(message);
+    bool ok = shared->share && shared->share->refcount >= 1 && shared->share->destroy;
+    if (ok) {
+        nadi_message_retain(shared);
+        nadi_message_release(shared);
+    }
+    message->free(message);
+
+    nadi_message* result = nadi::message_pool::instance().allocate("result", 1);
+    *static_cast<char*>(result->data) = ok ? 1 : 0;
+    result->channel = 1;
+    result->node = node;
+    receive(result);
+    return NADI_OK;
+}
+
+DLL_EXPORT void nadi_free(nadi_message* message) {
+    message->free(message);
+}
+
+DLL_EXPORT nadi_status nadi_descriptor(char* buffer, size_t* length) {
+    return node_descriptor.write(buffer, length);
+}
+
+DLL_EXPORT nadi_status nadi_descriptor_view(const char** descriptor, size_t* length) {
+    return node_descriptor.view(descriptor, length);
+}
+
+} // extern "C"
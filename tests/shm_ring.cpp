@@ -0,0 +1,85 @@
+// Drives one ring of a nadi_shm segment in ordinary memory, without a peer process: slots are
+// committed up to the ring's capacity, released out of order, and the tail only advances over
+// released slots at its front. Also checks the space_wanted handshake and stale positions.
+
+#include "shm/segment.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <new>
+
+namespace shm = nadi::shm;
+
+namespace {
+
+constexpr std::uint32_t slot_count = 4;
+constexpr std::uint64_t slot_size = 64;
+
+int failures = 0;
+
+bool check(bool ok, const char* what, int line) {
+    if (ok) return true;
+    std::fprintf(stderr, "shm_ring.cpp:%d: %s\n", line, what);
+    ++failures;
+    return false;
+}
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+void fill(const shm::ring_view& ring, std::uint64_t count) {
+    for (std::uint64_t i = 0; i < count; ++i) {
+        std::uint64_t position;
+        if (!CHECK(ring.reserve(position))) return;
+        ring.commit(position);
+    }
+}
+
+} // namespace
+
+int main() {
+    std::size_t size = shm::segment_size(slot_count, slot_size);
+    void* memory = ::operator new(size, std::align_val_t{shm::cache_line});
+    std::memset(memory, 0, size);
+    auto* segment = new (memory) shm::segment_header{};
+    segment->slot_count = slot_count;
+    segment->slot_size = slot_size;
+    shm::ring_view ring{*segment, 0};
+    const shm::ring_header& header = segment->rings[0];
+
+    CHECK(ring.available() == slot_count);
+    fill(ring, slot_count);
+    std::uint64_t position;
+    CHECK(!ring.reserve(position));
+    CHECK(ring.available() == 0);
+    CHECK(ring.ready(0) && ring.ready(3));
+    CHECK(!ring.ready(4));
+
+    // released behind the front, the tail waits for slot 0
+    CHECK(!ring.release(2));
+    CHECK(!ring.release(1));
+    CHECK(header.tail.load() == 0);
+    CHECK(ring.available() == 0);
+    CHECK(!ring.release(0));
+    CHECK(header.tail.load() == 3);
+    CHECK(ring.available() == 3);
+
+    // a slot reused for a later position is not ready for the stale one
+    fill(ring, 3);
+    CHECK(ring.ready(4) && ring.ready(6));
+    CHECK(!ring.ready(0));
+
+    // the writer asks for space on a full ring and is told about it once
+    CHECK(ring.want_space());
+    CHECK(ring.release(3));
+    CHECK(!ring.release(4));
+    CHECK(header.tail.load() == 5);
+    CHECK(!ring.want_space()); // space is free, so it retries instead
+    CHECK(ring.release(5));    // that request is still answered once
+    CHECK(!ring.release(6));
+    CHECK(header.tail.load() == 7);
+    CHECK(ring.available() == slot_count);
+
+    segment->~segment_header();
+    ::operator delete(memory, std::align_val_t{shm::cache_line});
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,72 @@
+// Checks read_frame, which splits the byte stream of nadi_uds into frames: complete frames inline
+// and in a memfd, incomplete ones at every cut, and the headers and metas it must reject.
+
+#include "uds/frame.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+namespace uds = nadi::uds;
+
+namespace {
+
+int failures = 0;
+
+bool check(bool ok, const char* what, int line) {
+    if (ok) return true;
+    std::fprintf(stderr, "uds_frame.cpp:%d: %s\n", line, what);
+    ++failures;
+    return false;
+}
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+std::string encode(uds::frame_header header, std::string_view meta, std::string_view data) {
+    std::string bytes{reinterpret_cast<const char*>(&header), sizeof(header)};
+    bytes += meta;
+    bytes += data;
+    return bytes;
+}
+
+uds::frame_header header_of(std::uint32_t flags, std::uint64_t data_length, std::uint32_t meta_length) {
+    return {uds::frame_magic, flags, 7, 42, data_length, 3, meta_length};
+}
+
+uds::frame_status read(const std::string& bytes, std::size_t size = std::string::npos) {
+    uds::frame_header header;
+    std::size_t length;
+    return uds::read_frame(bytes.data(), std::min(size, bytes.size()), header, length);
+}
+
+} // namespace
+
+int main() {
+    using uds::frame_status;
+    std::string meta{"json", 5};
+    std::string inline_frame = encode(header_of(0, 3, 5), meta, "abc");
+    std::string memfd_frame = encode(header_of(uds::frame_memfd, 5ull << 30, 5), meta, {});
+    std::string stream = inline_frame + memfd_frame;
+
+    uds::frame_header header;
+    std::size_t length = 0;
+    CHECK(uds::read_frame(stream.data(), stream.size(), header, length) == frame_status::complete);
+    CHECK(length == inline_frame.size());
+    CHECK(header.channel == 3 && header.meta_hash == 42 && header.data_length == 3);
+    // memfd payloads are not in the stream, however large
+    CHECK(uds::read_frame(stream.data() + length, stream.size() - length, header, length) == frame_status::complete);
+    CHECK(length == sizeof(uds::frame_header) + meta.size());
+    CHECK(header.data_length == 5ull << 30);
+
+    for (std::size_t size = 0; size < inline_frame.size(); ++size) CHECK(read(inline_frame, size) == frame_status::incomplete);
+
+    uds::frame_header bad_magic = header_of(0, 3, 5);
+    bad_magic.magic = 0;
+    CHECK(read(encode(bad_magic, meta, "abc")) == frame_status::invalid);
+    CHECK(read(encode(header_of(0, 3, 0), {}, "abc")) == frame_status::invalid);
+    CHECK(read(encode(header_of(0, 3, 4), "json", "abc")) == frame_status::invalid);
+    // inline payloads past 4 GiB cannot be framed, which shows in the header alone
+    CHECK(read(encode(header_of(0, NADI_EXTENDED, 5), {}, {})) == frame_status::invalid);
+    return failures == 0 ? 0 : 1;
+}
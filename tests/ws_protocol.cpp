@@ -0,0 +1,82 @@
+// Checks the I/O-free parts of the WebSocket gateway against RFC 6455: the accept key of its
+// sample handshake, the sample frames of section 5.7, frame headers of every length encoding, and
+// base64 as used for binary payloads in text frames.
+
+#include "ws/protocol.hpp"
+
+#include <cstdio>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+
+namespace ws = nadi::ws;
+
+namespace {
+
+int failures = 0;
+
+bool check(bool ok, const char* what, int line) {
+    if (ok) return true;
+    std::fprintf(stderr, "ws_protocol.cpp:%d: %s\n", line, what);
+    ++failures;
+    return false;
+}
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+std::string bytes(std::initializer_list<unsigned char> values) {
+    return {values.begin(), values.end()};
+}
+
+std::string decoded(std::string_view text) {
+    std::string out;
+    return ws::decode_base64(text, out) ? out : "<invalid>";
+}
+
+} // namespace
+
+int main() {
+    CHECK(ws::accept_key("dGhlIHNhbXBsZSBub25jZQ==") == "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=");
+
+    ws::frame frame;
+    std::string hello = bytes({0x81, 0x05, 0x48, 0x65, 0x6c, 0x6c, 0x6f});
+    CHECK(ws::parse_frame(hello, frame));
+    CHECK(frame.first_byte == (ws::fin_bit | ws::opcode::text) && !frame.masked && frame.length == 5 && frame.header_size == 2);
+
+    std::string masked = bytes({0x81, 0x85, 0x37, 0xfa, 0x21, 0x3d, 0x7f, 0x9f, 0x4d, 0x51, 0x58});
+    if (CHECK(ws::parse_frame(masked, frame) && frame.masked && frame.length == 5 && frame.header_size == 6)) {
+        std::string payload = masked.substr(frame.header_size);
+        ws::unmask(payload.data(), payload.size(), frame.mask);
+        CHECK(payload == "Hello");
+    }
+
+    CHECK(ws::parse_frame(bytes({0x82, 0x7E, 0x01, 0x00}), frame) && frame.length == 256 && frame.header_size == 4);
+    CHECK(ws::parse_frame(bytes({0x82, 0x7F, 0, 0, 0, 0, 0, 1, 0, 0}), frame) && frame.length == 65536 && frame.header_size == 10);
+    // more bytes needed: the header, its extended length or its mask is cut off
+    CHECK(!ws::parse_frame(bytes({0x81}), frame));
+    CHECK(!ws::parse_frame(bytes({0x82, 0x7E, 0x01}), frame));
+    CHECK(!ws::parse_frame(bytes({0x82, 0x7F, 0, 0, 0, 0, 0, 1, 0}), frame));
+    CHECK(!ws::parse_frame(masked.substr(0, 5), frame));
+
+    for (std::size_t length : {0u, 125u, 126u, 0xFFFFu, 0x10000u}) {
+        std::string header;
+        ws::append_frame_header(header, ws::fin_bit | ws::opcode::binary, length);
+        CHECK(ws::parse_frame(header, frame) && frame.length == length && frame.header_size == header.size() && !frame.masked);
+    }
+
+    std::string prefix;
+    ws::append_le32(prefix, 0xF0001234);
+    CHECK(prefix.size() == 4 && ws::read_le32(prefix.data()) == 0xF0001234);
+
+    std::string encoded;
+    ws::append_base64(encoded, "Man", 3);
+    ws::append_base64(encoded, "Ma", 2);
+    ws::append_base64(encoded, "M", 1);
+    CHECK(encoded == "TWFuTWE=TQ==");
+    CHECK(decoded("TWFuTWE=") == "ManMa");
+    CHECK(decoded("") == "");
+    CHECK(decoded("TQ=") == "<invalid>");
+    CHECK(decoded("TQ==TWFu") == "<invalid>");
+    CHECK(decoded("TW-u") == "<invalid>");
+    return failures == 0 ? 0 : 1;
+}